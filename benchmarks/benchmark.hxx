@@ -0,0 +1,87 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#ifndef CXXLOG_BENCHMARKS_BENCHMARK_HXX_
+#define CXXLOG_BENCHMARKS_BENCHMARK_HXX_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace bench {
+
+using clock = std::chrono::steady_clock;
+
+/// @brief Keeps a value alive so that the loop computing it is not removed
+template<typename T>
+void keep(const T &value) {
+  static volatile T sink;
+  sink = value;
+  static_cast<void>(sink);
+}
+
+/// @brief Runs `f(i)` for `iterations` times and returns nanoseconds per call
+template<typename Function>
+double measure(std::size_t iterations, Function &&f) {
+  const auto start = clock::now();
+  for (std::size_t i = 0; i < iterations; ++i) {
+    f(i);
+  }
+  const auto elapsed = clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+      static_cast<double>(iterations);
+}
+
+inline void report(const char *name, double ns_per_op) {
+  std::printf("%-48s %10.2f ns/op\n", name, ns_per_op);
+}
+
+/// @brief Times each call of `f(i)` and prints p50, p99 and p99.9
+template<typename Function>
+void report_latency(const char *name, std::size_t iterations, Function &&f) {
+  std::vector<double> samples(iterations);
+  for (std::size_t i = 0; i < iterations; ++i) {
+    const auto start = clock::now();
+    f(i);
+    const auto elapsed = clock::now() - start;
+    samples[i] = std::chrono::duration<double, std::nano>(elapsed).count();
+  }
+  std::sort(samples.begin(), samples.end());
+  const auto at = [&samples](double p) {
+    return samples[static_cast<std::size_t>(p * (samples.size() - 1))];
+  };
+  std::printf("%-48s p50 %8.0f  p99 %8.0f  p99.9 %8.0f ns\n",
+      name, at(0.5), at(0.99), at(0.999));
+}
+
+/// @brief Stream buffer that discards everything
+class null_buffer : public std::streambuf {
+ protected:
+  int_type overflow(int_type ch) override {
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    return n;
+  }
+};
+
+/// @brief Output stream that discards everything
+class null_stream : public std::ostream {
+ public:
+  null_stream() : std::ostream(&buffer_) {
+  }
+
+ private:
+  null_buffer buffer_;
+};
+
+}  // namespace bench
+
+#endif  // CXXLOG_BENCHMARKS_BENCHMARK_HXX_
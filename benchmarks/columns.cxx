@@ -0,0 +1,58 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <cstddef>
+#include <thread>
+
+#include "cxxlog/cxxlog.hxx"
+#include "benchmark.hxx"
+
+namespace {
+
+struct thread_id_column {
+  void operator()(const cxxlog::col::arguments &args) {
+    args.out << '[' << std::hex << std::this_thread::get_id() << ']';
+  }
+};
+
+}  // namespace
+
+// Cost of the columns specified by cols().
+int main() {
+  const std::size_t iterations = 2000000;
+  bench::null_stream null;
+
+  bench::report("default columns", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null) << i;
+  }));
+  bench::report("cols()", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols() << i;
+  }));
+  bench::report("cols(time, severity)", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols(cxxlog::col::time(), cxxlog::col::severity()) << i;
+  }));
+  bench::report("cols<time, severity>()", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols<cxxlog::col::time, cxxlog::col::severity>() << i;
+  }));
+  bench::report("cols<coarse_time, severity>()", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols<cxxlog::col::coarse_time, cxxlog::col::severity>()
+        << i;
+  }));
+  bench::report("cols<iso8601, severity>()", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols<cxxlog::col::iso8601, cxxlog::col::severity>() << i;
+  }));
+  bench::report("cols<time, severity, thread id>()",
+      bench::measure(iterations, [&null](std::size_t i) {
+    CXXLOG_I(null).cols<cxxlog::col::time, cxxlog::col::severity,
+        thread_id_column>() << i;
+  }));
+  return 0;
+}
@@ -0,0 +1,52 @@
+#
+# Copyright (c) 2022 Hiroshi Nakashima
+#
+# This software is released under the MIT License, see LICENSE.
+#
+# cmake -DCXX=<compiler> -DSOURCE=<file> -DINCLUDE=<dir> [-DREPEAT=<n>]
+#       -DOUTPUT=<dir> -P compile_time.cmake
+#
+# Compiles a translation unit with the header-only and the compiled library
+# modes and prints the mean compile time, the preprocessed size and the
+# object size of each. Requires CMake 3.23 for sub-second timestamps.
+if(NOT REPEAT)
+    set(REPEAT 10)
+endif()
+
+set(flags -std=c++11 -O2 -I${INCLUDE} -DCXXLOG_LEVEL=cxxlog::verbose)
+
+foreach(mode header compiled)
+    set(mode_flags ${flags})
+    if(mode STREQUAL "compiled")
+        list(APPEND mode_flags -DCXXLOG_COMPILED_LIB=1)
+    endif()
+    set(object "${OUTPUT}/compile_time_${mode}.o")
+
+    execute_process(
+        COMMAND ${CXX} ${mode_flags} -E ${SOURCE}
+        OUTPUT_VARIABLE preprocessed
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${mode}: preprocessing failed")
+    endif()
+    string(LENGTH "${preprocessed}" preprocessed_size)
+
+    string(TIMESTAMP begin "%s%f")
+    foreach(i RANGE 1 ${REPEAT})
+        execute_process(
+            COMMAND ${CXX} ${mode_flags} -c ${SOURCE} -o ${object}
+            RESULT_VARIABLE result
+        )
+        if(NOT result EQUAL 0)
+            message(FATAL_ERROR "${mode}: compilation failed")
+        endif()
+    endforeach()
+    string(TIMESTAMP end "%s%f")
+    math(EXPR ms "(${end} - ${begin}) / 1000 / ${REPEAT}")
+
+    file(SIZE "${object}" object_size)
+    message("compile time (${mode}): ${ms} ms per translation unit,"
+        " ${preprocessed_size} preprocessed bytes,"
+        " ${object_size} object bytes")
+endforeach()
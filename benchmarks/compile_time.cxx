@@ -0,0 +1,27 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+// A translation unit of a typical user of the logger, compiled by
+// compile_time.cmake with and without CXXLOG_COMPILED_LIB.
+#include <ostream>
+#include <string>
+
+#include "cxxlog/cxxlog.hxx"
+
+void compile_time_connect(std::ostream &out, const std::string &host,
+    int port) {
+  CXXLOG_I(out) << "connecting to " << host << ':' << port;
+  CXXLOG_W(out).kv("host", host).kv("port", port) << "slow handshake";
+}
+
+void compile_time_request(std::ostream &out, double elapsed, bool cached) {
+  CXXLOG_D(out).cols<cxxlog::col::time, cxxlog::col::location>()
+      << "request took " << elapsed << " ms, cached " << cached;
+  CXXLOG_EVERY_N(cxxlog::info, 100)(out) << "sampled request";
+}
+
+void compile_time_failure(std::ostream &out, const char *reason) {
+  CXXLOG_E(out) << "request failed: " << reason;
+}
@@ -0,0 +1,29 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <cstddef>
+
+#include "cxxlog/cxxlog.hxx"
+#include "benchmark.hxx"
+
+// Latency of constructing, formatting and destroying a Logger.
+int main() {
+  const std::size_t iterations = 1000000;
+  bench::null_stream null;
+
+  bench::report_latency("Logger, null stream", iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null) << "latency " << i;
+  });
+  bench::report_latency("Logger, null stream, no columns", iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols() << "latency " << i;
+  });
+  bench::report_latency("Logger, no data inserted", iterations,
+      [&null](std::size_t) {
+    CXXLOG_I(null);
+  });
+  return 0;
+}
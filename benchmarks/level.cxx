@@ -0,0 +1,44 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <cstddef>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/structured.hxx"
+#include "benchmark.hxx"
+
+double disabled_at_compile_time(std::size_t iterations);
+
+// Cost of a record whose level is disabled.
+int main() {
+  const std::size_t iterations = 100000000;
+  cxxlog::set_level(cxxlog::info);
+  cxxlog::category category(cxxlog::warning);
+
+  bench::report("empty loop", bench::measure(iterations, [](std::size_t i) {
+    bench::keep(i);
+  }));
+  bench::report("CXXLOG_D (disabled at compile time)",
+      disabled_at_compile_time(iterations));
+  bench::report("CXXLOG_D (disabled at runtime)",
+      bench::measure(iterations, [](std::size_t i) {
+    bench::keep(i);
+    CXXLOG_D << "disabled " << i;
+  }));
+  bench::report("CXXLOG_C(category, info) (disabled by category)",
+      bench::measure(iterations, [&category](std::size_t i) {
+    bench::keep(i);
+    CXXLOG_C(category, cxxlog::info) << "disabled " << i;
+  }));
+
+  bench::null_stream null;
+  cxxlog::structured_sink filtered(cxxlog::record_format::text, null);
+  filtered.set_level(cxxlog::warning);
+  bench::report("CXXLOG_I(sink) (disabled by the sink)",
+      bench::measure(iterations, [&filtered](std::size_t i) {
+    CXXLOG_I(filtered).kv("index", i) << "disabled " << i;
+  }));
+  return 0;
+}
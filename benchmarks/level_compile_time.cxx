@@ -0,0 +1,19 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <cstddef>
+
+// debug is disabled at compile time in this translation unit only
+#undef CXXLOG_LEVEL
+#define CXXLOG_LEVEL cxxlog::info
+#include "cxxlog/cxxlog.hxx"
+#include "benchmark.hxx"
+
+double disabled_at_compile_time(std::size_t iterations) {
+  return bench::measure(iterations, [](std::size_t i) {
+    bench::keep(i);
+    CXXLOG_D << "disabled " << i;
+  });
+}
@@ -0,0 +1,30 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+#include "cxxlog/cxxlog.hxx"
+
+// Built twice: as is, and with CXXLOG_STRIP_BELOW=3. strip_check.cmake
+// compares the sizes and verifies that no text of the stripped levels is
+// left in the second executable.
+int main(int argc, char **argv) {
+  std::ostringstream out;
+  const std::string name = (argc > 0) ? argv[0] : "";
+  for (int i = 0; i < argc; ++i) {
+    CXXLOG_W(out) << "cxxlog strip check warning " << name << ' ' << i;
+    CXXLOG_I(out) << "cxxlog strip check info " << name << ' ' << i;
+    CXXLOG_I(out).cols<cxxlog::col::iso8601>()
+        << "cxxlog strip check info columns " << 0.5 * i;
+    CXXLOG_D(out) << "cxxlog strip check debug " << &out << ' ' << i;
+    CXXLOG_D(out, std::cerr).cols() << "cxxlog strip check debug streams";
+    CXXLOG_V(out) << "cxxlog strip check verbose " << std::hex << i;
+    CXXLOG_V(out).cols<cxxlog::col::local_time, cxxlog::col::severity>()
+        << "cxxlog strip check verbose columns " << name.size();
+  }
+  return out.str().empty() ? 1 : 0;
+}
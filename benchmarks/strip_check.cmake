@@ -0,0 +1,29 @@
+#
+# Copyright (c) 2022 Hiroshi Nakashima
+#
+# This software is released under the MIT License, see LICENSE.
+#
+# cmake -DFULL=<executable> -DSTRIPPED=<executable> -P strip_check.cmake
+#
+# Fails if the executable built with CXXLOG_STRIP_BELOW=3 still contains the
+# text of info, debug or verbose logs, and prints the sizes of both.
+set(pattern "cxxlog strip check (info|debug|verbose)")
+
+file(STRINGS "${FULL}" kept REGEX "${pattern}")
+if(NOT kept)
+    message(FATAL_ERROR "${FULL}: log text not found")
+endif()
+
+file(STRINGS "${STRIPPED}" leaked REGEX "${pattern}")
+if(leaked)
+    message(FATAL_ERROR "${STRIPPED}: stripped log text found: ${leaked}")
+endif()
+
+foreach(file FULL STRIPPED)
+    file(READ "${${file}}" content HEX)
+    string(LENGTH "${content}" length)
+    math(EXPR ${file}_size "${length} / 2")
+endforeach()
+math(EXPR saved "${FULL_size} - ${STRIPPED_size}")
+message("strip check: ${FULL_size} -> ${STRIPPED_size} bytes"
+    " (${saved} bytes stripped)")
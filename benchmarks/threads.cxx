@@ -0,0 +1,66 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cxxlog/cxxlog.hxx"
+#include "benchmark.hxx"
+
+namespace {
+
+// Total records per second of `threads` threads logging concurrently.
+template<typename Function>
+double run(unsigned threads, std::size_t iterations, Function f) {
+  std::vector<std::thread> workers;
+  const auto start = bench::clock::now();
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([t, iterations, &f] {
+      for (std::size_t i = 0; i < iterations; ++i) {
+        f(t, i);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  const auto elapsed = std::chrono::duration<double>(
+      bench::clock::now() - start).count();
+  return static_cast<double>(threads * iterations) / elapsed;
+}
+
+}  // namespace
+
+// Scaling of the output path from 1 to N threads.
+int main() {
+  const std::size_t iterations = 200000;
+  const unsigned max_threads =
+      std::max(2u, std::thread::hardware_concurrency());
+
+  bench::null_stream shared;
+  std::vector<std::unique_ptr<bench::null_stream>> own;
+  for (unsigned t = 0; t < max_threads; ++t) {
+    own.emplace_back(new bench::null_stream());
+  }
+
+  std::printf("%-8s %20s %20s\n", "threads", "shared stream/s", "own stream/s");
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    const auto shared_rate = run(threads, iterations,
+        [&shared](unsigned, std::size_t i) {
+      CXXLOG_I(shared) << "threads " << i;
+    });
+    const auto own_rate = run(threads, iterations,
+        [&own](unsigned t, std::size_t i) {
+      CXXLOG_I(*own[t]) << "threads " << i;
+    });
+    std::printf("%-8u %20.0f %20.0f\n", threads, shared_rate, own_rate);
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/binary.hxx"
+#include "cxxlog/file_sink.hxx"
+#include "benchmark.hxx"
+
+// Single thread throughput of enabled records.
+int main() {
+  const std::size_t iterations = 1000000;
+  bench::null_stream null;
+
+  bench::report("null stream", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null) << "throughput " << i << ' ' << 3.14;
+  }));
+  bench::report("null stream, no columns", bench::measure(iterations,
+      [&null](std::size_t i) {
+    CXXLOG_I(null).cols() << "throughput " << i << ' ' << 3.14;
+  }));
+  {
+    std::ofstream file("bench_throughput_ofstream.txt");
+    bench::report("std::ofstream", bench::measure(iterations,
+        [&file](std::size_t i) {
+      CXXLOG_I(file) << "throughput " << i << ' ' << 3.14;
+    }));
+  }
+  {
+    cxxlog::file_sink file("bench_throughput_file_sink.txt");
+    bench::report("cxxlog::file_sink", bench::measure(iterations,
+        [&file](std::size_t i) {
+      CXXLOG_I(file) << "throughput " << i << ' ' << 3.14;
+    }));
+  }
+  {
+    cxxlog::file_sink file("bench_throughput_binary.bin");
+    cxxlog::binary::writer writer(file);
+    bench::report("binary::writer to cxxlog::file_sink",
+        bench::measure(iterations, [&writer](std::size_t i) {
+      CXXLOG_BIN_I(writer, "throughput {} {}", i, 3.14);
+    }));
+  }
+  {
+    cxxlog::start_async();
+    bench::report("null stream, asynchronous (enqueue)",
+        bench::measure(iterations, [&null](std::size_t i) {
+      CXXLOG_I(null) << "throughput " << i << ' ' << 3.14;
+    }));
+    cxxlog::stop_async();
+  }
+  std::remove("bench_throughput_ofstream.txt");
+  std::remove("bench_throughput_file_sink.txt");
+  std::remove("bench_throughput_binary.bin");
+  return 0;
+}
@@ -0,0 +1,9 @@
+#
+# Copyright (c) 2022 Hiroshi Nakashima
+#
+# This software is released under the MIT License, see LICENSE.
+#
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+
+include("${CMAKE_CURRENT_LIST_DIR}/cxxlog-targets.cmake")
@@ -11,7 +11,9 @@ Singleton& Singleton::get_instance() {
 }
 
 Singleton::Singleton()
-    : stream_("log_advanced.txt") {
+    : stream_("log_advanced.txt"), channel_(std::cout, stream_) {
+  channel_.cols<
+      cxxlog::col::time, cxxlog::col::severity, cxxlog::col::thread>();
   CXXLOG_I << "Singleton.ctor";
 }
 
@@ -22,3 +24,7 @@ Singleton::~Singleton() {
 std::ostream& Singleton::get_stream() {
   return stream_;
 }
+
+cxxlog::channel& Singleton::get_channel() {
+  return channel_;
+}
@@ -8,13 +8,10 @@
 
 #include <fstream>
 #include <iostream>
-#include <thread>
 
 #include "cxxlog/cxxlog.hxx"
 
-#define ADVANCED_LOG_I \
-  CXXLOG_I(std::cout, Singleton::get_instance().get_stream()) \
-    .cols(cxxlog::col::time(), cxxlog::col::severity(), thread_id_column())
+#define ADVANCED_LOG_I CXXLOG_CH_I(Singleton::get_instance().get_channel())
 
 class Singleton {
  public:
@@ -26,6 +23,7 @@ class Singleton {
   Singleton& operator=(Singleton&&) = delete;
 
   std::ostream& get_stream();
+  cxxlog::channel& get_channel();
 
  private:
   Singleton();
@@ -33,12 +31,7 @@ class Singleton {
 
  private:
   std::ofstream stream_;
-};
-
-struct thread_id_column {
-  void operator()(const cxxlog::col::arguments &args) {
-    args.out << '[' << std::hex << std::this_thread::get_id() << ']';
-  }
+  cxxlog::channel channel_;
 };
 
 #endif  // CXXLOG_EXAMPLES_ADVANCED_HXX_
@@ -9,6 +9,7 @@
 #include <thread>
 
 #include "cxxlog/cxxlog.hxx"
+#include "cxxlog/file_sink.hxx"
 #include "advanced.hxx"
 
 int main() {
@@ -49,6 +50,11 @@ int main() {
   CXXLOG_E(&std::cerr, &fs) << "multiple output streams (ptr)";
   CXXLOG_E(std::cerr, &fs) << "multiple output streams (mix)";
 
+  // sink: buffered file
+  cxxlog::file_sink file("log_sink.txt");
+  CXXLOG_I(file) << "buffered until an error or the buffer is full";
+  CXXLOG_E(file, std::cerr) << "sink and stream";
+
   // checks log level
   if (CXXLOG_CHECK(cxxlog::warning)) {
     CXXLOG(cxxlog::none) << "warning or higher";
@@ -63,12 +69,19 @@ int main() {
   // customize columns
   CXXLOG_E.cols() << "----------------------- no columns";
   CXXLOG_E.cols(cxxlog::col::time()) << "----- time column only";
+  CXXLOG_E.cols<cxxlog::col::severity>() << "----- severity column only";
+
+  // rate limiting
+  for (int i = 0; i < 10; ++i) {
+    CXXLOG_EVERY_N(cxxlog::error, 5) << "every 5th log. i=" << i;
+  }
 
   // advanced
   ADVANCED_LOG_I << "advanced log";
 
   // thread safe
   std::thread thread([]{
+    cxxlog::set_thread_name("worker");
     for (int i = 0; i < 100; ++i) {
       ADVANCED_LOG_I << i;
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
@@ -80,5 +93,12 @@ int main() {
   }
   thread.join();
 
+  // asynchronous backend
+  cxxlog::start_async();
+  for (int i = 0; i < 10; ++i) {
+    CXXLOG_I << "asynchronous log. i=" << i;
+  }
+  cxxlog::stop_async();
+
   return 0;
 }
@@ -0,0 +1,205 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_ASYNC_SINK_HXX_
+#define CXXLOG_ASYNC_SINK_HXX_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/backend.hxx"
+
+namespace cxxlog {
+
+/// @brief Sink that writes to another destination on its own thread
+///
+/// Each asynchronous sink has a queue and a writer thread, so a slow
+/// destination does not delay the others nor the logging thread. A record
+/// sent to several asynchronous sinks is copied once into a
+/// cxxlog::shared_record, which the sinks release when they have written
+/// it. `async_options::capacity` and `async_options::overflow` configure
+/// the queue.
+///
+/// Like cxxlog::file_sink, the sink is flushed after a fatal record, and
+/// the crash handler writes the records still queued to its descriptor.
+/// @code {.cxx}
+/// cxxlog::file_sink file("log.txt");
+/// cxxlog::async_sink slow(file);
+/// cxxlog::async_sink console(std::cerr);
+/// CXXLOG_E(slow, console) << "one copy, two writer threads";
+/// @endcode
+class async_sink : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] out - output stream or cxxlog::sink to write to
+  /// @param[in] options - queue capacity and overflow policy
+  template<typename Output>
+  explicit async_sink(
+      Output &&out, const async_options &options = async_options())
+      : out_(detail::make_destination(
+            detail::to_ptr(std::forward<Output>(out)))),
+        overflow_(options.overflow),
+        queue_(options.capacity),
+        completed_(0),
+        dropped_(0),
+        sleeping_(false),
+        stopping_(false) {
+    writer_ = std::thread(&async_sink::run, this);
+    detail::buffered_sinks<>::add(this, &async_sink::emergency_write);
+  }
+
+  async_sink(const async_sink&) = delete;
+  async_sink& operator=(const async_sink&) = delete;
+
+  /// @brief Destructor
+  ///
+  /// Writes the queued records and stops the writer thread.
+  ~async_sink() override {
+    detail::buffered_sinks<>::remove(this);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_cv_.notify_one();
+    writer_.join();
+  }
+
+  void write(const record &r) override {
+    write_shared(shared_record(r));
+  }
+
+  bool shared() const override {
+    return true;
+  }
+
+  void write_shared(const shared_record &r) override {
+    const auto fill = [&r](shared_record &slot) {
+      slot = r;
+    };
+    while (!queue_.try_push(fill)) {
+      if (overflow_ == overflow_policy::drop_newest) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      } else if (overflow_ == overflow_policy::drop_oldest) {
+        if (queue_.try_pop(release)) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          completed_.fetch_add(1, std::memory_order_release);
+        }
+      } else {
+        wake_writer();
+        std::this_thread::yield();
+      }
+    }
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+      wake_writer();
+    }
+  }
+
+  /// @brief Waits until the records queued so far have been written, then
+  /// flushes the destination
+  void flush() override {
+    const auto target = queue_.push_count();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (completed_.load(std::memory_order_acquire) < target) {
+        wake_cv_.notify_one();
+        idle_cv_.wait_for(lock, std::chrono::milliseconds(10));
+      }
+    }
+    detail::flush_destination(out_);
+  }
+
+  bool structured() const override {
+    return out_.sink != nullptr && out_.sink->structured();
+  }
+
+  /// @brief Number of records discarded by the overflow policy
+  std::size_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static void release(shared_record &slot) {
+    slot = shared_record();
+  }
+
+  static void emergency_write(
+      sink *s, detail::buffered_sinks<>::emergency_output output) {
+    const auto write = [output](const shared_record &slot) {
+      if (slot) {
+        const auto r = slot.view();
+        output(r.data, r.size);
+      }
+    };
+    static_cast<async_sink*>(s)->queue_.peek(write);
+  }
+
+  void wake_writer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_cv_.notify_one();
+  }
+
+  bool idle() const {
+    return queue_.push_count() == completed_.load(std::memory_order_acquire);
+  }
+
+  void drain() {
+    const auto write = [this](shared_record &slot) {
+      detail::write_destination(slot.view(), out_);
+      slot = shared_record();
+    };
+    while (queue_.try_pop(write)) {
+      completed_.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      lock.unlock();
+      drain();
+      // a short spin picks up a steady stream of records without wake-ups
+      for (int i = 0; i < 64 && idle(); ++i) {
+        std::this_thread::yield();
+      }
+      lock.lock();
+      idle_cv_.notify_all();
+      if (stopping_) {
+        lock.unlock();
+        drain();
+        return;
+      }
+      sleeping_.store(true, std::memory_order_seq_cst);
+      if (idle()) {
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(100));
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  const detail::destination out_;
+  const overflow_policy overflow_;
+  detail::bounded_queue<shared_record> queue_;
+  std::atomic<std::size_t> completed_;
+  std::atomic<std::size_t> dropped_;
+  std::atomic<bool> sleeping_;
+  bool stopping_;
+  std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable idle_cv_;
+  std::thread writer_;
+};
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_ASYNC_SINK_HXX_
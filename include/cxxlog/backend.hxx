@@ -0,0 +1,890 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+// included first so that this header can come before cxxlog/cxxlog.hxx,
+// whose implementation includes it back
+#include "cxxlog/cxxlog.hxx"
+
+#ifndef CXXLOG_BACKEND_HXX_
+#define CXXLOG_BACKEND_HXX_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Queues and writer threads of the background backends. Only classes are
+// defined here, so any translation unit can include this header, also with
+// CXXLOG_COMPILED_LIB.
+
+namespace cxxlog {
+
+namespace detail {
+
+/// @brief Formatted record handed to the writer thread
+///
+/// `text` holds the line followed by the encoded fields. Records live in
+/// the slots of the queue and are overwritten in place, so the storage of
+/// `text` is reused instead of being allocated by a producer and freed by
+/// the writer thread.
+struct queued_record {
+  severity_t severity;
+  timestamp time;
+  std::string text;
+  destination_list destinations;
+  std::size_t size;
+  std::size_t message_offset;
+  std::size_t message_size;
+
+  /// @brief Copies a record into the storage of the slot
+  /// @return false if the record did not fit and `text` had to grow
+  bool assign(const record &r, destination_list &&list) {
+    const auto total = r.size + r.fields_size;
+    if (text.capacity() > CXXLOG_RETAINED_BUFFER_SIZE &&
+        total <= CXXLOG_RETAINED_BUFFER_SIZE) {
+      std::string().swap(text);
+    }
+    const bool fits = total <= text.capacity();
+    text.assign(r.data, r.size);
+    if (r.fields_size != 0) {
+      text.append(r.fields, r.fields_size);
+    }
+    severity = r.severity;
+    time = r.time;
+    destinations = std::move(list);
+    size = r.size;
+    message_offset = r.message_offset;
+    message_size = r.message_size;
+    return fits;
+  }
+
+  void write() const {
+    write_destinations(
+        { severity, text.data(), size, time, message_offset, message_size,
+          text.data() + size, text.size() - size },
+        destinations);
+  }
+};
+
+/// @brief Bounded lock-free queue (Vyukov's sequenced ring buffer)
+///
+/// Many threads push and a single writer thread pops. Producers may also
+/// pop to implement @ref overflow_policy::drop_oldest.
+template<typename T>
+class bounded_queue {
+ public:
+  explicit bounded_queue(std::size_t capacity)
+      : mask_(round_up(capacity) - 1),
+        cells_(new cell[mask_ + 1]),
+        enqueue_pos_(0),
+        dequeue_pos_(0) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bounded_queue(const bounded_queue&) = delete;
+  bounded_queue& operator=(const bounded_queue&) = delete;
+
+  /// @brief Visits every slot; only called before the first push
+  template<typename F>
+  void initialize(F &&init) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      init(cells_[i].value);
+    }
+  }
+
+  /// @brief Claims a slot and lets `fill` overwrite its value in place
+  template<typename F>
+  bool try_push(F &&fill) {
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &c = cells_[pos & mask_];
+      const auto seq = c.sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          fill(c.value);
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// @brief Claims the oldest value and lets `consume` read it in place
+  ///
+  /// The slot is handed back to the producers when `consume` returns.
+  template<typename F>
+  bool try_pop(F &&consume) {
+    auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto &c = cells_[pos & mask_];
+      const auto seq = c.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq) -
+          static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          consume(c.value);
+          c.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /// @brief Number of records ever pushed
+  std::size_t push_count() const {
+    return enqueue_pos_.load(std::memory_order_acquire);
+  }
+
+  /// @brief Visits the values pushed but not popped yet, without locking
+  ///
+  /// Only meant for the crash handler: a value popped concurrently may be
+  /// visited while it is being moved out.
+  template<typename F>
+  void peek(F &&visit) const {
+    const auto end = enqueue_pos_.load(std::memory_order_acquire);
+    for (auto pos = dequeue_pos_.load(std::memory_order_acquire);
+         pos != end; ++pos) {
+      const auto &c = cells_[pos & mask_];
+      if (c.sequence.load(std::memory_order_acquire) == pos + 1) {
+        visit(c.value);
+      }
+    }
+  }
+
+ private:
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  static std::size_t round_up(std::size_t n) {
+    std::size_t size = 2;
+    while (size < n) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const std::size_t mask_;
+  const std::unique_ptr<cell[]> cells_;
+  // producer and consumer positions live on separate cache lines
+  char pad0_[64];
+  std::atomic<std::size_t> enqueue_pos_;
+  char pad1_[64];
+  std::atomic<std::size_t> dequeue_pos_;
+};
+
+/// @brief Asynchronous backend draining records on a writer thread
+class async_backend {
+ public:
+  static async_backend& instance() {
+    static async_backend backend;
+    return backend;
+  }
+
+  async_backend(const async_backend&) = delete;
+  async_backend& operator=(const async_backend&) = delete;
+
+  void start(const async_options &options) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (writer_.joinable()) {
+      return;
+    }
+    overflow_ = options.overflow;
+    queue_.reset(new bounded_queue<queued_record>(options.capacity));
+    block_size_ = options.block_size;
+    queue_->initialize([this](queued_record &slot) {
+      slot.text.reserve(block_size_);
+    });
+    completed_.store(0, std::memory_order_relaxed);
+    stopping_ = false;
+    writer_ = std::thread(&async_backend::run, this);
+    running_.store(true, std::memory_order_release);
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (!writer_.joinable()) {
+      return;
+    }
+    running_.store(false, std::memory_order_seq_cst);
+    while (producers_.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+    {
+      std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+      stopping_ = true;
+    }
+    wake_cv_.notify_one();
+    writer_.join();
+  }
+
+  void flush() {
+    if (!running_.load(std::memory_order_acquire)) {
+      return;
+    }
+    const auto target = queue_->push_count();
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (completed_.load(std::memory_order_acquire) < target &&
+           running_.load(std::memory_order_acquire)) {
+      wake_cv_.notify_one();
+      idle_cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+  }
+
+  /// @brief Hands a record to the writer thread
+  /// @return false if the backend is not running
+  bool push(const record &r, destination_list &&destinations) {
+    if (!running_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    producers_.fetch_add(1, std::memory_order_seq_cst);
+    if (!running_.load(std::memory_order_seq_cst)) {
+      producers_.fetch_sub(1, std::memory_order_release);
+      return false;
+    }
+    bool fits = true;
+    const auto fill = [&](queued_record &slot) {
+      fits = slot.assign(r, std::move(destinations));
+    };
+    while (!queue_->try_push(fill)) {
+      if (overflow_ == overflow_policy::drop_newest) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      } else if (overflow_ == overflow_policy::drop_oldest) {
+        if (queue_->try_pop([](queued_record&) {})) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          completed_.fetch_add(1, std::memory_order_release);
+        }
+      } else {
+        wake_writer();
+        std::this_thread::yield();
+      }
+    }
+    if (!fits) {
+      sink_stats::oversized();
+    }
+    producers_.fetch_sub(1, std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+      wake_writer();
+    }
+    return true;
+  }
+
+  std::size_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  /// @brief Number of records waiting for the writer thread
+  std::size_t queued() const {
+    if (!running_.load(std::memory_order_acquire)) {
+      return 0;
+    }
+    const auto pushed = queue_->push_count();
+    const auto completed = completed_.load(std::memory_order_acquire);
+    return (pushed > completed) ? pushed - completed : 0;
+  }
+
+  /// @brief Number of preallocated record slots and their text size
+  std::pair<std::size_t, std::size_t> pool() const {
+    if (!running_.load(std::memory_order_acquire)) {
+      return { 0, 0 };
+    }
+    return { queue_->capacity(), block_size_ };
+  }
+
+  /// @brief Visits the queued records without locking (crash handler)
+  template<typename F>
+  void peek(F &&visit) const {
+    if (running_.load(std::memory_order_acquire)) {
+      queue_->peek(visit);
+    }
+  }
+
+ private:
+  async_backend()
+      : running_(false),
+        sleeping_(false),
+        stopping_(false),
+        producers_(0),
+        completed_(0),
+        dropped_(0),
+        overflow_(overflow_policy::block),
+        block_size_(0) {
+  }
+
+  ~async_backend() {
+    stop();
+  }
+
+  void wake_writer() {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_cv_.notify_one();
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    for (;;) {
+      lock.unlock();
+      drain();
+      lock.lock();
+      idle_cv_.notify_all();
+      if (stopping_) {
+        lock.unlock();
+        drain();
+        return;
+      }
+      // a short spin picks up a steady stream of records without wake-ups
+      lock.unlock();
+      for (int i = 0; i < 64 && queue_->push_count() ==
+           completed_.load(std::memory_order_relaxed); ++i) {
+        std::this_thread::yield();
+      }
+      lock.lock();
+      sleeping_.store(true, std::memory_order_seq_cst);
+      if (queue_->push_count() == completed_.load(std::memory_order_acquire)) {
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(100));
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  void drain() {
+    const auto write = [](const queued_record &r) {
+      r.write();
+    };
+    while (queue_->try_pop(write)) {
+      completed_.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  std::mutex control_mutex_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable idle_cv_;
+  std::atomic<bool> running_;
+  std::atomic<bool> sleeping_;
+  bool stopping_;
+  std::atomic<int> producers_;
+  std::atomic<std::size_t> completed_;
+  std::atomic<std::size_t> dropped_;
+  overflow_policy overflow_;
+  std::size_t block_size_;
+  std::unique_ptr<bounded_queue<queued_record>> queue_;
+  std::thread writer_;
+};
+
+/// @brief Single-producer single-consumer ring buffer
+template<typename T>
+class spsc_ring {
+ public:
+  explicit spsc_ring(std::size_t capacity)
+      : mask_(round_up(capacity) - 1),
+        items_(new T[mask_ + 1]),
+        head_(0),
+        tail_(0) {
+  }
+
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring& operator=(const spsc_ring&) = delete;
+
+  /// @brief Visits every slot; only called before the first push
+  template<typename F>
+  void initialize(F &&init) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      init(items_[i]);
+    }
+  }
+
+  /// @brief Called by the producer; `fill` overwrites a slot in place
+  template<typename F>
+  bool try_push(F &&fill) {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+    fill(items_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /// @brief Called by the consumer
+  std::size_t size() const {
+    return head_.load(std::memory_order_acquire) -
+        tail_.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Called by the consumer if size() is not 0
+  T& front() {
+    return items_[tail_.load(std::memory_order_relaxed) & mask_];
+  }
+
+  /// @brief Called by the consumer if size() is not 0
+  void pop() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+  }
+
+  /// @brief Visits the values not popped yet (crash handler)
+  template<typename F>
+  void peek(F &&visit) const {
+    const auto head = head_.load(std::memory_order_acquire);
+    for (auto pos = tail_.load(std::memory_order_acquire); pos != head;
+         ++pos) {
+      visit(items_[pos & mask_]);
+    }
+  }
+
+ private:
+  static std::size_t round_up(std::size_t n) {
+    std::size_t size = 2;
+    while (size < n) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  const std::size_t mask_;
+  const std::unique_ptr<T[]> items_;
+  // producer and consumer positions live on separate cache lines
+  char pad0_[64];
+  std::atomic<std::size_t> head_;
+  char pad1_[64];
+  std::atomic<std::size_t> tail_;
+};
+
+/// @brief Per-thread backend merging thread-local rings on a collector
+///
+/// Each logging thread appends records to its own ring, so logging threads
+/// never touch shared state on the hot path. The collector thread merges
+/// the rings in timestamp order and writes the records. A ring of an exited
+/// thread is drained before it is released.
+class thread_backend {
+ public:
+  static thread_backend& instance() {
+    static thread_backend backend;
+    return backend;
+  }
+
+  thread_backend(const thread_backend&) = delete;
+  thread_backend& operator=(const thread_backend&) = delete;
+
+  void start(const thread_buffer_options &options) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (collector_.joinable()) {
+      return;
+    }
+    options_ = options;
+    stopping_ = false;
+    generation_.fetch_add(1, std::memory_order_relaxed);
+    collector_ = std::thread(&thread_backend::run, this);
+    running_.store(true, std::memory_order_release);
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (!collector_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> rings_lock(rings_mutex_);
+      running_.store(false, std::memory_order_seq_cst);
+      for (const auto &ring : rings_) {
+        while (ring->busy.load(std::memory_order_seq_cst)) {
+          std::this_thread::yield();
+        }
+      }
+    }
+    {
+      std::lock_guard<std::mutex> wake_lock(wake_mutex_);
+      stopping_ = true;
+    }
+    wake_cv_.notify_one();
+    collector_.join();
+    std::lock_guard<std::mutex> rings_lock(rings_mutex_);
+    rings_.clear();
+  }
+
+  void flush() {
+    if (!running_.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    ++flushing_;
+    // a pass that started after this call has finished
+    const auto target = passes_ + 2;
+    while (passes_ < target && running_.load(std::memory_order_acquire)) {
+      wake_cv_.notify_one();
+      idle_cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    --flushing_;
+  }
+
+  /// @brief Appends a record to the ring of the calling thread
+  /// @return false if the backend is not running
+  bool push(const record &r, destination_list &&destinations) {
+    if (!running_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    const auto ring = local_ring();
+    if (ring == nullptr) {
+      return false;
+    }
+    ring->busy.store(true, std::memory_order_seq_cst);
+    if (!running_.load(std::memory_order_seq_cst)) {
+      ring->busy.store(false, std::memory_order_release);
+      return false;
+    }
+    bool fits = true;
+    const auto fill = [&](timed_record &slot) {
+      slot.timestamp = r.time.to_microseconds();
+      fits = slot.record.assign(r, std::move(destinations));
+    };
+    while (!ring->records.try_push(fill)) {
+      if (options_.overflow != overflow_policy::block) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+      std::this_thread::yield();
+    }
+    ring->busy.store(false, std::memory_order_release);
+    if (!fits) {
+      sink_stats::oversized();
+    }
+    return true;
+  }
+
+  std::size_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  /// @brief Number of records waiting in the rings
+  std::size_t queued() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    std::size_t total = 0;
+    for (const auto &ring : rings_) {
+      total += ring->records.size();
+    }
+    return total;
+  }
+
+  /// @brief Number of preallocated record slots and their text size
+  std::pair<std::size_t, std::size_t> pool() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    std::size_t slots = 0;
+    for (const auto &ring : rings_) {
+      slots += ring->records.capacity();
+    }
+    return { slots, rings_.empty() ? 0 : options_.block_size };
+  }
+
+  /// @brief Visits the buffered records of all threads (crash handler)
+  ///
+  /// The rings are skipped if another thread holds the list of rings.
+  template<typename F>
+  void peek(F &&visit) {
+    if (!running_.load(std::memory_order_acquire) ||
+        !rings_mutex_.try_lock()) {
+      return;
+    }
+    for (const auto &ring : rings_) {
+      ring->records.peek([&visit](const timed_record &item) {
+        visit(item.record);
+      });
+    }
+    rings_mutex_.unlock();
+  }
+
+ private:
+  struct timed_record {
+    std::int64_t timestamp;
+    queued_record record;
+  };
+
+  using head = std::pair<std::int64_t, std::size_t>;
+
+  struct thread_ring {
+    thread_ring(std::size_t capacity, std::size_t block_size,
+        std::uint64_t generation)
+        : records(capacity), busy(false), closed(false),
+          generation(generation) {
+      records.initialize([block_size](timed_record &slot) {
+        slot.record.text.reserve(block_size);
+      });
+    }
+
+    spsc_ring<timed_record> records;
+    std::atomic<bool> busy;
+    std::atomic<bool> closed;
+    const std::uint64_t generation;
+  };
+
+  /// @brief Marks the ring of a thread as closed when the thread exits
+  struct ring_owner {
+    ring_owner() {
+      state() = alive;
+    }
+
+    ~ring_owner() {
+      if (ring) {
+        ring->closed.store(true, std::memory_order_release);
+      }
+      state() = destroyed;
+    }
+
+    std::shared_ptr<thread_ring> ring;
+  };
+
+  enum state_t { uninitialized, alive, destroyed };
+
+  static state_t& state() {
+    static thread_local state_t state = uninitialized;
+    return state;
+  }
+
+  thread_backend()
+      : running_(false),
+        stopping_(false),
+        generation_(0),
+        dropped_(0),
+        passes_(0),
+        flushing_(0) {
+  }
+
+  ~thread_backend() {
+    stop();
+  }
+
+  /// @return nullptr while the thread is exiting
+  thread_ring* local_ring() {
+    if (state() == destroyed) {
+      return nullptr;
+    }
+    static thread_local ring_owner owner;
+    const auto generation = generation_.load(std::memory_order_relaxed);
+    if (!owner.ring || owner.ring->generation != generation) {
+      std::shared_ptr<thread_ring> ring(
+          new thread_ring(options_.capacity, options_.block_size, generation));
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      if (!running_.load(std::memory_order_relaxed)) {
+        return nullptr;
+      }
+      if (owner.ring) {
+        owner.ring->closed.store(true, std::memory_order_release);
+      }
+      rings_.push_back(ring);
+      owner.ring = std::move(ring);
+    }
+    return owner.ring.get();
+  }
+
+  void run() {
+    const auto window = std::chrono::duration_cast<std::chrono::microseconds>(
+        options_.collect_interval).count();
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    for (;;) {
+      // records younger than the poll interval wait for the next pass, so
+      // that slightly older records of other threads can be merged first
+      auto cutoff = std::numeric_limits<std::int64_t>::max();
+      if (flushing_ == 0) {
+        cutoff = col::precise_clock::now().to_microseconds() - window;
+      }
+      lock.unlock();
+      const bool collected = collect(cutoff);
+      lock.lock();
+      ++passes_;
+      idle_cv_.notify_all();
+      if (stopping_) {
+        lock.unlock();
+        while (collect(std::numeric_limits<std::int64_t>::max())) {
+        }
+        return;
+      }
+      if (!collected && flushing_ == 0) {
+        wake_cv_.wait_for(lock, options_.collect_interval);
+      }
+    }
+  }
+
+  /// @brief Writes the records buffered at the start of the call which are
+  /// not newer than `cutoff`
+  /// @return false if no record was written
+  bool collect(std::int64_t cutoff) {
+    {
+      std::lock_guard<std::mutex> lock(rings_mutex_);
+      snapshot_ = rings_;
+    }
+    // a min-heap of the oldest record of each ring, kept between passes
+    const std::greater<head> later;
+    heads_.clear();
+    pending_.assign(snapshot_.size(), 0);
+    for (std::size_t i = 0; i < snapshot_.size(); ++i) {
+      pending_[i] = snapshot_[i]->records.size();
+      if (pending_[i] != 0) {
+        heads_.emplace_back(snapshot_[i]->records.front().timestamp, i);
+      }
+    }
+    std::make_heap(heads_.begin(), heads_.end(), later);
+    bool collected = false;
+    while (!heads_.empty() && heads_.front().first <= cutoff) {
+      collected = true;
+      std::pop_heap(heads_.begin(), heads_.end(), later);
+      const auto i = heads_.back().second;
+      heads_.pop_back();
+      auto &records = snapshot_[i]->records;
+      records.front().record.write();
+      records.pop();
+      if (--pending_[i] != 0) {
+        heads_.emplace_back(records.front().timestamp, i);
+        std::push_heap(heads_.begin(), heads_.end(), later);
+      }
+    }
+    release_closed_rings();
+    snapshot_.clear();
+    return collected;
+  }
+
+  void release_closed_rings() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (auto it = rings_.begin(); it != rings_.end();) {
+      if ((*it)->closed.load(std::memory_order_acquire) &&
+          (*it)->records.size() == 0) {
+        it = rings_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  std::mutex control_mutex_;
+  std::mutex rings_mutex_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable idle_cv_;
+  std::atomic<bool> running_;
+  bool stopping_;
+  std::atomic<std::uint64_t> generation_;
+  std::atomic<std::size_t> dropped_;
+  std::uint64_t passes_;
+  int flushing_;
+  thread_buffer_options options_;
+  std::vector<std::shared_ptr<thread_ring>> rings_;
+  std::vector<std::shared_ptr<thread_ring>> snapshot_;
+  std::vector<std::size_t> pending_;
+  std::vector<head> heads_;
+  std::thread collector_;
+};
+
+/// @brief Thread flushing streams and buffered sinks periodically
+class periodic_flusher {
+ public:
+  static periodic_flusher& instance() {
+    static periodic_flusher flusher;
+    return flusher;
+  }
+
+  periodic_flusher(const periodic_flusher&) = delete;
+  periodic_flusher& operator=(const periodic_flusher&) = delete;
+
+  void start(std::chrono::milliseconds period) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (thread_.joinable()) {
+      return;
+    }
+    period_ = period;
+    stopping_ = false;
+    stream_flush<>::tracking.store(true, std::memory_order_relaxed);
+    thread_ = std::thread(&periodic_flusher::run, this);
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (!thread_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> wake_lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    stream_flush<>::tracking.store(false, std::memory_order_relaxed);
+    // no pointer to a stream is kept once the flusher is stopped
+    flush_dirty_streams();
+  }
+
+ private:
+  periodic_flusher() : stopping_(false) {
+  }
+
+  ~periodic_flusher() {
+    stop();
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, period_, [this] { return stopping_; })) {
+      lock.unlock();
+      flush_dirty_streams();
+      buffered_sinks<>::flush_all();
+      lock.lock();
+    }
+  }
+
+  std::mutex control_mutex_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::chrono::milliseconds period_;
+  bool stopping_;
+  std::thread thread_;
+};
+
+}  // namespace detail
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_BACKEND_HXX_
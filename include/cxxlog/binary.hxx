@@ -0,0 +1,801 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_BINARY_HXX_
+#define CXXLOG_BINARY_HXX_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cxxlog/cxxlog.hxx"
+
+/// @brief Macro for binary log
+///
+/// The format string and the source location are registered once per call
+/// site; each record stores only the site id, the time and the raw bytes of
+/// the arguments. Each `{}` in the format is replaced by the next argument
+/// when the record is formatted by cxxlog::binary::formatter or decoded by
+/// the `cxxlog_decode` tool.
+/// @code {.cxx}
+/// cxxlog::file_sink file("log.bin");
+/// cxxlog::binary::writer writer(file);
+/// CXXLOG_BIN(cxxlog::info, writer, "user {} logged in from {}", id, host);
+/// @endcode
+#define CXXLOG_BIN(severity, destination, ...) \
+  CXXLOG_CHECK(severity) && cxxlog::binary::log( \
+      []() -> cxxlog::binary::site& { \
+        static cxxlog::binary::site site(__FILE__, __LINE__, severity); \
+        return site; \
+      }(), destination, __VA_ARGS__)
+
+/// @brief Macro for fatal binary log
+#define CXXLOG_BIN_F(destination, ...) \
+  CXXLOG_BIN(cxxlog::fatal, destination, __VA_ARGS__)
+
+/// @brief Macro for error binary log
+#define CXXLOG_BIN_E(destination, ...) \
+  CXXLOG_BIN(cxxlog::error, destination, __VA_ARGS__)
+
+/// @brief Macro for warning binary log
+#define CXXLOG_BIN_W(destination, ...) \
+  CXXLOG_BIN(cxxlog::warning, destination, __VA_ARGS__)
+
+/// @brief Macro for information binary log
+#define CXXLOG_BIN_I(destination, ...) \
+  CXXLOG_BIN(cxxlog::info, destination, __VA_ARGS__)
+
+/// @brief Macro for debug binary log
+#define CXXLOG_BIN_D(destination, ...) \
+  CXXLOG_BIN(cxxlog::debug, destination, __VA_ARGS__)
+
+/// @brief Macro for verbose binary log
+#define CXXLOG_BIN_V(destination, ...) \
+  CXXLOG_BIN(cxxlog::verbose, destination, __VA_ARGS__)
+
+namespace cxxlog {
+
+/// @brief Namespace of cxxlog binary log
+///
+/// A binary log is a sequence of frames. Each frame starts with a one byte
+/// kind and a four byte size of the rest of the frame. Integers are stored
+/// in the byte order of the writing machine.
+///
+/// | kind         | payload                                              |
+/// |--------------|------------------------------------------------------|
+/// | session (0)  | magic `CXXLOGB\0`, u32 version                       |
+/// | site (1)     | u32 id, u8 severity, u32 line, u32 + file, u32 + format |
+/// | record (2)   | u32 site id, i64 time (usec), u32 thread, arguments  |
+///
+/// Site ids are valid until the next session frame. Each argument is a one
+/// byte type followed by its value (strings are u32 length + bytes).
+namespace binary {
+
+/// @brief Kinds of frames
+enum frame_kind : std::uint8_t {
+  session_frame = 0,
+  site_frame = 1,
+  record_frame = 2,
+};
+
+/// @brief Types of arguments
+enum arg_type : std::uint8_t {
+  bool_arg = 'b',
+  char_arg = 'c',
+  int_arg = 'i',
+  uint_arg = 'u',
+  double_arg = 'd',
+  string_arg = 's',
+  pointer_arg = 'p',
+};
+
+/// @brief Size of the kind and size fields of a frame
+constexpr std::size_t frame_header_size = 5;
+
+/// @brief Size of a record frame without arguments
+constexpr std::size_t record_header_size = frame_header_size + 4 + 8 + 4;
+
+/// @brief Version stored in session frames
+constexpr std::uint32_t format_version = 1;
+
+class site;
+
+}  // namespace binary
+
+namespace detail {
+
+/// @brief Process-wide table of binary log call sites
+class site_registry {
+ public:
+  /// @brief Maximum number of call sites
+  static constexpr std::uint32_t max_sites = 65536;
+
+  static site_registry& instance() {
+    static site_registry registry;
+    return registry;
+  }
+
+  /// @return id of the site, or 0 if the table is full
+  std::uint32_t add(binary::site *s, const char *format);
+
+  /// @return site of the id, or nullptr
+  const binary::site* find(std::uint32_t id) const {
+    if (id == 0 || id > count_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return chunks_[(id - 1) / chunk_size][(id - 1) % chunk_size];
+  }
+
+ private:
+  static constexpr std::uint32_t chunk_size = 1024;
+
+  site_registry() : count_(0) {
+  }
+
+  std::mutex mutex_;
+  std::atomic<std::uint32_t> count_;
+  std::unique_ptr<const binary::site*[]> chunks_[max_sites / chunk_size];
+};
+
+}  // namespace detail
+
+namespace binary {
+
+/// @brief Static information of a call site
+/// @see CXXLOG_BIN
+class site {
+ public:
+  site(const char *file, int line, severity_t severity)
+      : file_(file), line_(line), severity_(severity), format_(nullptr),
+        id_(0) {
+  }
+
+  site(const site&) = delete;
+  site& operator=(const site&) = delete;
+
+  /// @brief Id of the site, registering it on the first call
+  std::uint32_t id(const char *format) {
+    const auto id = id_.load(std::memory_order_acquire);
+    return (id != 0) ? id : detail::site_registry::instance().add(this, format);
+  }
+
+  const char* file() const {
+    return file_;
+  }
+
+  int line() const {
+    return line_;
+  }
+
+  severity_t severity() const {
+    return severity_;
+  }
+
+  const char* format() const {
+    return format_;
+  }
+
+ private:
+  friend class detail::site_registry;
+
+  const char *const file_;
+  const int line_;
+  const severity_t severity_;
+  const char *format_;
+  std::atomic<std::uint32_t> id_;
+};
+
+}  // namespace binary
+
+namespace detail {
+
+inline std::uint32_t site_registry::add(
+    binary::site *s, const char *format) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto id = s->id_.load(std::memory_order_relaxed);
+  if (id != 0) {
+    return id;
+  }
+  const auto index = count_.load(std::memory_order_relaxed);
+  if (index == max_sites) {
+    return 0;
+  }
+  auto &chunk = chunks_[index / chunk_size];
+  if (!chunk) {
+    chunk.reset(new const binary::site*[chunk_size]);
+  }
+  chunk[index % chunk_size] = s;
+  s->format_ = format;
+  id = index + 1;
+  count_.store(id, std::memory_order_release);
+  s->id_.store(id, std::memory_order_release);
+  return id;
+}
+
+template<typename T>
+void put_raw(std::vector<char> *out, const T &value) {
+  const auto bytes = reinterpret_cast<const char*>(&value);
+  out->insert(out->end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+T get_raw(const char *data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+inline void put_string(std::vector<char> *out, const char *s, std::size_t n) {
+  put_raw(out, static_cast<std::uint32_t>(n));
+  out->insert(out->end(), s, s + n);
+}
+
+/// @brief Category of an argument type, see arg_kind()
+enum arg_kind_t {
+  bool_kind, char_kind, int_kind, uint_kind, double_kind, string_kind,
+  pointer_kind, other_kind,
+};
+
+template<typename T, typename D = typename std::decay<T>::type>
+constexpr arg_kind_t arg_kind() {
+  return std::is_same<D, bool>::value ? bool_kind :
+      (std::is_same<D, char>::value || std::is_same<D, signed char>::value ||
+       std::is_same<D, unsigned char>::value) ? char_kind :
+      (std::is_integral<D>::value && std::is_signed<D>::value) ? int_kind :
+      std::is_integral<D>::value ? uint_kind :
+      std::is_enum<D>::value ? int_kind :
+      std::is_floating_point<D>::value ? double_kind :
+      (std::is_same<D, const char*>::value || std::is_same<D, char*>::value ||
+       std::is_same<D, std::string>::value) ? string_kind :
+      std::is_pointer<D>::value ? pointer_kind : other_kind;
+}
+
+template<arg_kind_t K>
+using arg_tag = std::integral_constant<arg_kind_t, K>;
+
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<bool_kind>) {
+  out->push_back(static_cast<char>(binary::bool_arg));
+  out->push_back(value ? 1 : 0);
+}
+
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<char_kind>) {
+  out->push_back(static_cast<char>(binary::char_arg));
+  out->push_back(static_cast<char>(value));
+}
+
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<int_kind>) {
+  out->push_back(static_cast<char>(binary::int_arg));
+  put_raw(out, static_cast<std::int64_t>(value));
+}
+
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<uint_kind>) {
+  out->push_back(static_cast<char>(binary::uint_arg));
+  put_raw(out, static_cast<std::uint64_t>(value));
+}
+
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<double_kind>) {
+  out->push_back(static_cast<char>(binary::double_arg));
+  put_raw(out, static_cast<double>(value));
+}
+
+inline void encode_arg(
+    std::vector<char> *out, const char *value, arg_tag<string_kind>) {
+  out->push_back(static_cast<char>(binary::string_arg));
+  if (value == nullptr) {
+    put_string(out, "(null)", 6);
+  } else {
+    put_string(out, value, std::strlen(value));
+  }
+}
+
+inline void encode_arg(
+    std::vector<char> *out, const std::string &value, arg_tag<string_kind>) {
+  out->push_back(static_cast<char>(binary::string_arg));
+  put_string(out, value.data(), value.size());
+}
+
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<pointer_kind>) {
+  out->push_back(static_cast<char>(binary::pointer_arg));
+  put_raw(out, static_cast<std::uint64_t>(
+      reinterpret_cast<std::uintptr_t>(static_cast<const void*>(value))));
+}
+
+/// @brief Types without a binary encoding are formatted eagerly
+template<typename T>
+void encode_arg(std::vector<char> *out, const T &value, arg_tag<other_kind>) {
+  std::ostringstream text;
+  text << value;
+  const auto str = text.str();
+  encode_arg(out, str, arg_tag<string_kind>());
+}
+
+inline void encode_args(std::vector<char>*) {
+}
+
+template<typename T, typename... Args>
+void encode_args(std::vector<char> *out, const T &value, const Args &...args) {
+  encode_arg(out, value, arg_tag<arg_kind<T>()>());
+  encode_args(out, args...);
+}
+
+inline std::vector<char>& binary_buffer() {
+  static thread_local std::vector<char> buffer;
+  return buffer;
+}
+
+inline void begin_frame(std::vector<char> *out, binary::frame_kind kind) {
+  out->push_back(static_cast<char>(kind));
+  put_raw(out, std::uint32_t(0));
+}
+
+inline void end_frame(std::vector<char> *out, std::size_t begin) {
+  const auto size = static_cast<std::uint32_t>(
+      out->size() - begin - binary::frame_header_size);
+  std::memcpy(out->data() + begin + 1, &size, sizeof(size));
+}
+
+/// @brief Appends the text of one argument
+/// @return size of the argument, or 0 if it is malformed
+inline std::size_t format_arg(
+    const char *data, std::size_t size, std::string *out) {
+  if (size == 0) {
+    return 0;
+  }
+  char text[32];
+  switch (static_cast<std::uint8_t>(data[0])) {
+    case binary::bool_arg:
+      if (size < 2) {
+        return 0;
+      }
+      out->push_back(data[1] != 0 ? '1' : '0');
+      return 2;
+    case binary::char_arg:
+      if (size < 2) {
+        return 0;
+      }
+      out->push_back(data[1]);
+      return 2;
+    case binary::int_arg: {
+      if (size < 9) {
+        return 0;
+      }
+      const auto value = get_raw<std::int64_t>(data + 1);
+      auto end = text;
+      if (value < 0) {
+        *end++ = '-';
+      }
+      end = format_uint(end, (value < 0) ?
+          (0 - static_cast<std::uint64_t>(value)) :
+          static_cast<std::uint64_t>(value), 0);
+      out->append(text, end);
+      return 9;
+    }
+    case binary::uint_arg: {
+      if (size < 9) {
+        return 0;
+      }
+      const auto end = format_uint(text, get_raw<std::uint64_t>(data + 1), 0);
+      out->append(text, end);
+      return 9;
+    }
+    case binary::double_arg: {
+      if (size < 9) {
+        return 0;
+      }
+      const auto n = std::snprintf(
+          text, sizeof(text), "%g", get_raw<double>(data + 1));
+      out->append(text, static_cast<std::size_t>(n));
+      return 9;
+    }
+    case binary::pointer_arg: {
+      if (size < 9) {
+        return 0;
+      }
+      const auto n = std::snprintf(text, sizeof(text), "0x%llx",
+          static_cast<unsigned long long>(get_raw<std::uint64_t>(data + 1)));
+      out->append(text, static_cast<std::size_t>(n));
+      return 9;
+    }
+    case binary::string_arg: {
+      if (size < 5) {
+        return 0;
+      }
+      const auto n = get_raw<std::uint32_t>(data + 1);
+      if (size - 5 < n) {
+        return 0;
+      }
+      out->append(data + 5, n);
+      return 5 + n;
+    }
+    default:
+      return 0;
+  }
+}
+
+/// @brief Appends the format with `{}` replaced by the arguments
+///
+/// Arguments left over are appended separated by spaces.
+inline void format_message(const char *format, std::size_t format_size,
+    const char *args, std::size_t args_size, std::string *out) {
+  std::size_t i = 0;
+  while (i < format_size) {
+    if (format[i] == '{' && i + 1 < format_size && format[i + 1] == '}') {
+      const auto n = format_arg(args, args_size, out);
+      args += n;
+      args_size -= n;
+      i += 2;
+    } else {
+      out->push_back(format[i++]);
+    }
+  }
+  while (args_size > 0) {
+    out->push_back(' ');
+    const auto n = format_arg(args, args_size, out);
+    if (n == 0) {
+      break;
+    }
+    args += n;
+    args_size -= n;
+  }
+}
+
+/// @brief Appends a text line in the layout of the default columns
+inline void format_line(severity_t severity, std::int64_t timestamp,
+    const char *format, std::size_t format_size,
+    const char *args, std::size_t args_size, std::string *out) {
+  // a negative timestamp can only come from a damaged file
+  const auto micros =
+      static_cast<std::uint64_t>((timestamp < 0) ? 0 : timestamp);
+  char text[32];
+  auto end = format_uint(text, micros / 1000000, 10, ' ');
+  *end++ = '.';
+  end = format_uint(end, micros % 1000000, 6);
+  *end++ = ' ';
+  out->append(text, end);
+  out->append(severity_string(severity), 5);
+  out->push_back(' ');
+  format_message(format, format_size, args, args_size, out);
+  out->push_back('\n');
+}
+
+}  // namespace detail
+
+namespace binary {
+
+/// @brief Writes a binary record to the destination
+/// @see CXXLOG_BIN
+template<typename Destination, typename... Args>
+bool log(site &s, Destination &&destination, const char *format,
+    const Args &...args) {
+  const auto d = detail::make_destination(
+      detail::to_ptr(std::forward<Destination>(destination)));
+  if (d.sink != nullptr && !d.sink->enabled(s.severity())) {
+    return true;
+  }
+  const auto id = s.id(format);
+  if (id == 0) {
+    return false;
+  }
+  auto &buffer = detail::binary_buffer();
+  buffer.clear();
+  detail::begin_frame(&buffer, record_frame);
+  detail::put_raw(&buffer, id);
+  const auto now = col::precise_clock::now();
+  detail::put_raw(&buffer, now.to_microseconds());
+  detail::put_raw(&buffer, detail::thread_index());
+  detail::encode_args(&buffer, args...);
+  detail::end_frame(&buffer, 0);
+
+  const record r { s.severity(), buffer.data(), buffer.size(), now };
+  if (detail::background_running()) {
+    detail::publish(r, detail::destination_list(d));
+  } else {
+    detail::write_destination(r, d);
+  }
+  return true;
+}
+
+/// @brief Sink that stores binary records for offline decoding
+///
+/// The first record of each call site is preceded by a site frame, and a
+/// session frame is written on construction, so the output of several runs
+/// can be appended to one file. The output sink must keep the order of
+/// writes (e.g. cxxlog::file_sink).
+/// @code {.cxx}
+/// cxxlog::file_sink file("log.bin");
+/// cxxlog::binary::writer writer(file);
+/// CXXLOG_BIN_I(writer, "count={}", count);
+/// @endcode
+class writer : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] out - sink receiving the binary frames
+  explicit writer(sink &out)
+      : out_(out),
+        defined_(new std::atomic<std::uint64_t>[words]) {
+    for (std::size_t i = 0; i < words; ++i) {
+      defined_[i].store(0, std::memory_order_relaxed);
+    }
+    std::vector<char> frame;
+    detail::begin_frame(&frame, session_frame);
+    frame.insert(frame.end(), magic(), magic() + 8);
+    detail::put_raw(&frame, format_version);
+    detail::end_frame(&frame, 0);
+    out_.write({ none, frame.data(), frame.size(), timestamp() });
+  }
+
+  writer(const writer&) = delete;
+  writer& operator=(const writer&) = delete;
+
+  /// @brief Identifies the session frame
+  static const char* magic() {
+    return "CXXLOGB";
+  }
+
+  void write(const record &r) override {
+    // text records written to the writer by the log macros are ignored
+    if (r.size < record_header_size ||
+        static_cast<std::uint8_t>(r.data[0]) != record_frame) {
+      return;
+    }
+    const auto id = detail::get_raw<std::uint32_t>(
+        r.data + frame_header_size);
+    if (id == 0 || id > detail::site_registry::max_sites) {
+      return;
+    }
+    if (!defined(id)) {
+      define(id, r);
+    } else {
+      out_.write(r);
+    }
+  }
+
+  void flush() override {
+    out_.flush();
+  }
+
+ private:
+  static constexpr std::size_t words = detail::site_registry::max_sites / 64;
+
+  /// Ids run from 1 to max_sites, bit `id - 1` is the one of the site.
+  bool defined(std::uint32_t id) const {
+    return (defined_[(id - 1) / 64].load(std::memory_order_acquire) &
+        (std::uint64_t(1) << ((id - 1) % 64))) != 0;
+  }
+
+  /// @brief Writes the site frame together with the first record
+  void define(std::uint32_t id, const record &r) {
+    const auto s = detail::site_registry::instance().find(id);
+    if (s == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (defined(id)) {
+      out_.write(r);
+      return;
+    }
+    std::vector<char> frame;
+    detail::begin_frame(&frame, site_frame);
+    detail::put_raw(&frame, id);
+    frame.push_back(static_cast<char>(s->severity()));
+    detail::put_raw(&frame, static_cast<std::uint32_t>(s->line()));
+    detail::put_string(&frame, s->file(), std::strlen(s->file()));
+    detail::put_string(&frame, s->format(), std::strlen(s->format()));
+    detail::end_frame(&frame, 0);
+    frame.insert(frame.end(), r.data, r.data + r.size);
+    out_.write({ r.severity, frame.data(), frame.size(), r.time });
+    defined_[(id - 1) / 64].fetch_or(
+        std::uint64_t(1) << ((id - 1) % 64), std::memory_order_release);
+  }
+
+  sink &out_;
+  std::mutex mutex_;
+  const std::unique_ptr<std::atomic<std::uint64_t>[]> defined_;
+};
+
+/// @brief Sink that formats binary records as text lines
+///
+/// Combined with cxxlog::start_async(), the formatting happens on the
+/// writer thread instead of the logging thread.
+/// @code {.cxx}
+/// cxxlog::start_async();
+/// cxxlog::binary::formatter text(std::cout);
+/// CXXLOG_BIN_I(text, "count={}", count);
+/// @endcode
+class formatter : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] out - output stream or cxxlog::sink receiving the text
+  template<typename Output>
+  explicit formatter(Output &&out)
+      : out_(detail::make_destination(
+            detail::to_ptr(std::forward<Output>(out)))) {
+  }
+
+  void write(const record &r) override {
+    if (r.size < record_header_size ||
+        static_cast<std::uint8_t>(r.data[0]) != record_frame) {
+      return;
+    }
+    const auto s = detail::site_registry::instance().find(
+        detail::get_raw<std::uint32_t>(r.data + frame_header_size));
+    if (s == nullptr) {
+      return;
+    }
+    static thread_local std::string line;
+    line.clear();
+    detail::format_line(r.severity,
+        detail::get_raw<std::int64_t>(r.data + frame_header_size + 4),
+        s->format(), std::strlen(s->format()),
+        r.data + record_header_size, r.size - record_header_size, &line);
+    detail::write_destination(
+        { r.severity, line.data(), line.size(), r.time }, out_);
+  }
+
+  void flush() override {
+    if (out_.sink != nullptr) {
+      out_.sink->flush();
+    } else if (out_.stream != nullptr) {
+      out_.stream->flush();
+    }
+  }
+
+ private:
+  const detail::destination out_;
+};
+
+/// @brief Site read from a binary log
+struct site_info {
+  severity_t severity;
+  std::uint32_t line;
+  std::string file;
+  std::string format;
+};
+
+/// @brief Record read from a binary log
+struct entry {
+  const site_info *site;
+  /// @brief Microseconds since the epoch
+  std::int64_t timestamp;
+  std::uint32_t thread;
+  const char *args;
+  std::size_t args_size;
+
+  /// @brief Appends the record as a text line
+  void format(std::string *out) const {
+    detail::format_line(site->severity, timestamp, site->format.data(),
+        site->format.size(), args, args_size, out);
+  }
+};
+
+/// @brief Size of the frame at the beginning of the data, header included
+/// @return 0 if the data does not hold the whole frame
+inline std::size_t frame_size(const char *data, std::size_t size) {
+  if (size < frame_header_size) {
+    return 0;
+  }
+  const std::size_t total =
+      frame_header_size + detail::get_raw<std::uint32_t>(data + 1);
+  return (total <= size) ? total : 0;
+}
+
+/// @brief Reads frames written by cxxlog::binary::writer
+///
+/// A copy keeps the sites defined so far and shares them with the
+/// original, so the frames following a point of a log can be decoded by
+/// several threads from copies taken at that point.
+class decoder {
+ public:
+  decoder() : revision_(0) {
+  }
+
+  /// @brief Number of session and site frames decoded so far
+  ///
+  /// Copies taken at two points with the same revision are equivalent.
+  std::size_t revision() const {
+    return revision_;
+  }
+
+  /// @brief Decodes the frames in the data
+  ///
+  /// Calls `handler(const entry&)` for each record. A truncated frame at the
+  /// end (e.g. after a crash) is ignored. Definitions are kept, so the data
+  /// can be fed in consecutive chunks of whole frames.
+  /// @return number of bytes consumed
+  template<typename Handler>
+  std::size_t decode(const char *data, std::size_t size, Handler &&handler) {
+    std::size_t pos = 0;
+    while (size - pos >= frame_header_size) {
+      const auto kind = static_cast<std::uint8_t>(data[pos]);
+      const auto frame_size = detail::get_raw<std::uint32_t>(data + pos + 1);
+      if (size - pos - frame_header_size < frame_size) {
+        break;
+      }
+      const auto payload = data + pos + frame_header_size;
+      if (kind == session_frame) {
+        sites_.clear();
+        ++revision_;
+      } else if (kind == site_frame) {
+        define(payload, frame_size);
+        ++revision_;
+      } else if (kind == record_frame && frame_size >= 16) {
+        const auto id = detail::get_raw<std::uint32_t>(payload);
+        if (id < sites_.size() && sites_[id]) {
+          entry e {
+              sites_[id].get(),
+              detail::get_raw<std::int64_t>(payload + 4),
+              detail::get_raw<std::uint32_t>(payload + 12),
+              payload + 16,
+              frame_size - 16u,
+          };
+          handler(static_cast<const entry&>(e));
+        }
+      }
+      pos += frame_header_size + frame_size;
+    }
+    return pos;
+  }
+
+ private:
+  /// Definitions that a writer cannot produce (e.g. in a damaged file) are
+  /// ignored, so the records that refer to them are skipped.
+  void define(const char *payload, std::size_t size) {
+    if (size < 17) {
+      return;
+    }
+    const auto id = detail::get_raw<std::uint32_t>(payload);
+    if (id == 0 || id > detail::site_registry::max_sites) {
+      return;
+    }
+    const auto severity = static_cast<std::uint8_t>(payload[4]);
+    if (severity > verbose) {
+      return;
+    }
+    const std::size_t file_size = detail::get_raw<std::uint32_t>(payload + 9);
+    if (file_size > size - 17) {
+      return;
+    }
+    const std::size_t format_size =
+        detail::get_raw<std::uint32_t>(payload + 13 + file_size);
+    if (format_size > size - 17 - file_size) {
+      return;
+    }
+    std::shared_ptr<site_info> s(new site_info());
+    s->severity = static_cast<severity_t>(severity);
+    s->line = detail::get_raw<std::uint32_t>(payload + 5);
+    s->file.assign(payload + 13, file_size);
+    s->format.assign(payload + 17 + file_size, format_size);
+    if (sites_.size() <= id) {
+      sites_.resize(id + 1);
+    }
+    sites_[id] = std::move(s);
+  }
+
+  std::vector<std::shared_ptr<const site_info>> sites_;
+  std::size_t revision_;
+};
+
+}  // namespace binary
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_BINARY_HXX_
@@ -0,0 +1,237 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_CRASH_HANDLER_HXX_
+#define CXXLOG_CRASH_HANDLER_HXX_
+
+#if defined(_WIN32)
+#error "cxxlog/crash_handler.hxx requires POSIX signals"
+#endif
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+#include <signal.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/backend.hxx"
+
+namespace cxxlog {
+
+/// @brief Options of cxxlog::install_crash_handler()
+struct crash_options {
+  /// @brief Descriptor receiving the records still queued at the crash
+  ///
+  /// It must stay open for the lifetime of the program.
+  int fd = STDERR_FILENO;
+  /// @brief Whether std::terminate() is also handled
+  bool terminate = true;
+  /// @brief Whether the handler runs on an alternate stack
+  ///
+  /// This lets the handler run after a stack overflow of the thread that
+  /// installed it.
+  bool alternate_stack = true;
+};
+
+namespace detail {
+
+/// @brief State of the crash handler, constant-initialized
+template<typename T = void>
+struct crash_state {
+  static constexpr int signals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE,
+      SIGILL };
+  static constexpr std::size_t signal_count =
+      sizeof(signals) / sizeof(signals[0]);
+  static constexpr std::size_t stack_size = 64 * 1024;
+
+  static int fd;
+  static std::atomic<bool> installed;
+  static std::atomic<bool> entered;
+  static struct sigaction previous[signal_count];
+  static std::terminate_handler previous_terminate;
+  static char stack[stack_size];
+};
+
+template<typename T>
+constexpr int crash_state<T>::signals[];
+
+template<typename T>
+constexpr std::size_t crash_state<T>::signal_count;
+
+template<typename T>
+constexpr std::size_t crash_state<T>::stack_size;
+
+template<typename T>
+int crash_state<T>::fd = STDERR_FILENO;
+
+template<typename T>
+std::atomic<bool> crash_state<T>::installed(false);
+
+template<typename T>
+std::atomic<bool> crash_state<T>::entered(false);
+
+template<typename T>
+struct sigaction crash_state<T>::previous[signal_count];
+
+template<typename T>
+std::terminate_handler crash_state<T>::previous_terminate = nullptr;
+
+template<typename T>
+char crash_state<T>::stack[stack_size];
+
+/// @brief Async-signal-safe write of a whole buffer
+inline void crash_write(int fd, const char *data, std::size_t size) {
+  while (size > 0) {
+    const auto n = ::write(fd, data, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    data += n;
+    size -= static_cast<std::size_t>(n);
+  }
+}
+
+/// @brief Writes to the descriptor of the crash handler
+inline void crash_output(const char *data, std::size_t size) {
+  crash_write(crash_state<>::fd, data, size);
+}
+
+inline const char* signal_name(int signal) {
+  switch (signal) {
+    case SIGSEGV: return "SIGSEGV";
+    case SIGABRT: return "SIGABRT";
+    case SIGBUS: return "SIGBUS";
+    case SIGFPE: return "SIGFPE";
+    case SIGILL: return "SIGILL";
+    default: return "signal";
+  }
+}
+
+/// @brief Writes what is still in memory, once per process
+///
+/// The buffers of the sinks and the records queued by asynchronous sinks
+/// are written first, since they hold the older records, followed by the
+/// records waiting in the background backend and the reason of the crash.
+/// Only async-signal-safe calls are made, except for a try-lock of the
+/// per-thread rings.
+inline void crash_drain(const char *reason, std::size_t size) {
+  if (crash_state<>::entered.exchange(true)) {
+    return;
+  }
+  const auto fd = crash_state<>::fd;
+  buffered_sinks<>::write_all(&crash_output);
+  const auto write_pending = [fd](const queued_record &r) {
+    if (r.size <= r.text.size()) {
+      crash_write(fd, r.text.data(), r.size);
+    }
+  };
+  thread_backend::instance().peek(write_pending);
+  async_backend::instance().peek(write_pending);
+  crash_write(fd, reason, size);
+}
+
+inline void crash_signal_handler(int signal) {
+  char reason[64] = "cxxlog: caught ";
+  auto end = reason + std::strlen(reason);
+  const auto name = signal_name(signal);
+  const auto name_size = std::strlen(name);
+  std::memcpy(end, name, name_size);
+  end += name_size;
+  *end++ = ' ';
+  *end++ = '(';
+  end = format_uint(end, static_cast<std::uint64_t>(signal), 0);
+  *end++ = ')';
+  *end++ = '\n';
+  crash_drain(reason, static_cast<std::size_t>(end - reason));
+
+  // let the previous handler or the default action end the process
+  for (std::size_t i = 0; i < crash_state<>::signal_count; ++i) {
+    if (crash_state<>::signals[i] == signal) {
+      ::sigaction(signal, &crash_state<>::previous[i], nullptr);
+    }
+  }
+  ::raise(signal);
+}
+
+inline void crash_terminate_handler() {
+  static const char reason[] = "cxxlog: std::terminate called\n";
+  crash_drain(reason, sizeof(reason) - 1);
+  if (crash_state<>::previous_terminate != nullptr) {
+    crash_state<>::previous_terminate();
+  }
+  std::abort();
+}
+
+}  // namespace detail
+
+/// @brief Writes the records still in memory when the program crashes
+///
+/// On SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL and std::terminate(), the
+/// buffers of cxxlog::file_sink are written to their files, and the records
+/// still queued by the background backend are written to the descriptor
+/// opened beforehand, followed by the cause of the crash. The previous
+/// handler then runs, so the process still dumps core or reaches another
+/// crash reporter.
+///
+/// Only async-signal-safe calls are made. Records being written by the
+/// writer thread at the time of the crash may be lost or written twice.
+/// Records of stream destinations which are buffered by the stream itself
+/// are not recovered; log through a sink or use CXXLOG_F, which flushes
+/// everything before returning.
+/// @code {.cxx}
+/// cxxlog::crash_options crash;
+/// crash.fd = ::open("crash.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
+/// cxxlog::install_crash_handler(crash);
+/// cxxlog::start_async();
+/// @endcode
+/// @param[in] options - descriptor and handled events
+inline void install_crash_handler(
+    const crash_options &options = crash_options()) {
+  using state = detail::crash_state<>;
+  if (state::installed.exchange(true)) {
+    return;
+  }
+  state::fd = options.fd;
+  // the handler must not run the initialization of the backends
+  detail::thread_backend::instance();
+  detail::async_backend::instance();
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = &detail::crash_signal_handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_NODEFER;
+  if (options.alternate_stack) {
+    stack_t stack;
+    std::memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = state::stack;
+    stack.ss_size = state::stack_size;
+    if (::sigaltstack(&stack, nullptr) == 0) {
+      action.sa_flags |= SA_ONSTACK;
+    }
+  }
+  for (std::size_t i = 0; i < state::signal_count; ++i) {
+    ::sigaction(state::signals[i], &action, &state::previous[i]);
+  }
+  if (options.terminate) {
+    state::previous_terminate =
+        std::set_terminate(&detail::crash_terminate_handler);
+  }
+}
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_CRASH_HANDLER_HXX_
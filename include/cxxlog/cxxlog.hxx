@@ -8,15 +8,38 @@
 #ifndef CXXLOG_CXXLOG_HXX_
 #define CXXLOG_CXXLOG_HXX_
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <functional>
-#include <iomanip>
-#include <iostream>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <sstream>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
 /// @brief Specifies the log level
 ///
 /// This definition is specified by `target_compile_definitions` of cmake.
@@ -28,11 +51,90 @@
 #define CXXLOG_LEVEL cxxlog::error
 #endif  // CXXLOG_LEVEL
 
+/// @brief Strips the log macros of less severe levels at preprocessing time
+///
+/// A number from 0 (`cxxlog::none`) to 6 (`cxxlog::verbose`). The fixed
+/// severity macros (CXXLOG_F ... CXXLOG_V and CXXLOG_CH_F ... CXXLOG_CH_V)
+/// of levels above this number expand to a statement that is never
+/// executed, so neither the inserted values nor any instantiation of
+/// cxxlog::Logger reach the object file. Stripped macros can only be used
+/// as statements.
+/// @code
+/// target_compile_definitions(<target> PRIVATE CXXLOG_STRIP_BELOW=3)
+/// @endcode
+#ifndef CXXLOG_STRIP_BELOW
+#define CXXLOG_STRIP_BELOW 6
+#endif  // CXXLOG_STRIP_BELOW
+
+/// @brief Size of the buffer held inline by each record stream
+///
+/// Records up to this size, columns included, are formatted without
+/// touching the heap. Longer records spill to a heap block.
+#ifndef CXXLOG_INLINE_BUFFER_SIZE
+#define CXXLOG_INLINE_BUFFER_SIZE 512
+#endif  // CXXLOG_INLINE_BUFFER_SIZE
+
+/// @brief Largest spilled heap block kept for the next oversized record
+#ifndef CXXLOG_RETAINED_BUFFER_SIZE
+#define CXXLOG_RETAINED_BUFFER_SIZE (64 * 1024)
+#endif  // CXXLOG_RETAINED_BUFFER_SIZE
+
+/// @brief Enables the counters read by cxxlog::stats()
+///
+/// Set to 0 to compile the instrumentation out; cxxlog::stats() then
+/// returns zeros.
+/// @code
+/// target_compile_definitions(<target> PRIVATE CXXLOG_STATS=0)
+/// @endcode
+#ifndef CXXLOG_STATS
+#define CXXLOG_STATS 1
+#endif  // CXXLOG_STATS
+
+/// @brief Compiles the backend once in the `cxxlog_compiled` library
+///
+/// Set to 1 by linking `cxxlog::compiled` (`-DBUILD_COMPILED_LIB=ON`)
+/// instead of `cxxlog::cxxlog`. The header then declares the entry points,
+/// the backend functions and the destructor of cxxlog::Logger instead of
+/// defining them, and does not include `cxxlog/backend.hxx`, `<iostream>`,
+/// `<sstream>`, `<iomanip>`, `<thread>` or `<condition_variable>`. The
+/// front end used by the log macros is defined in this header in both
+/// modes. The other configuration macros must have the same values in the
+/// library and in the programs using it.
+/// @code
+/// target_link_libraries(<target> PRIVATE cxxlog::compiled)
+/// @endcode
+#ifndef CXXLOG_COMPILED_LIB
+#define CXXLOG_COMPILED_LIB 0
+#endif  // CXXLOG_COMPILED_LIB
+
+/// @brief Linkage of the functions defined by the compiled library
+#if CXXLOG_COMPILED_LIB
+#define CXXLOG_API
+#else
+#define CXXLOG_API inline
+#endif  // CXXLOG_COMPILED_LIB
+
+/// @brief Specifies the default columns
+///
+/// Comma separated list of built-in column types used when `cols()` is not
+/// called. The list is resolved at compile time.
+/// @code
+/// target_compile_definitions(<target> PRIVATE
+///     "CXXLOG_DEFAULT_COLUMNS=cxxlog::col::severity")
+/// @endcode
+#ifndef CXXLOG_DEFAULT_COLUMNS
+#define CXXLOG_DEFAULT_COLUMNS cxxlog::col::time, cxxlog::col::severity
+#endif  // CXXLOG_DEFAULT_COLUMNS
+
 /// @brief Macro that checks log level
+///
+/// The compile-time level is checked first, so levels disabled by
+/// @ref CXXLOG_LEVEL never read the runtime level.
 /// @code {.cxx}
 /// if (CXXLOG_CHECK(cxxlog::info)) { /* info or higher */ }
 /// @endcode
-#define CXXLOG_CHECK(level) (CXXLOG_LEVEL >= level)
+/// @see cxxlog::set_level
+#define CXXLOG_CHECK(level) (CXXLOG_LEVEL >= level && cxxlog::enabled(level))
 
 /// @brief Macro that optimizes logs by short-circuit evaluation
 ///
@@ -51,43 +153,216 @@
 /// false && (bool)(cxxlog::Logger(cxxlog::debug) << "logger is disabled");
 /// ^^^^^^^^
 /// @endcode
-#define CXXLOG(severity) CXXLOG_CHECK(severity) && cxxlog::Logger(severity)
+#define CXXLOG(severity) \
+  CXXLOG_CHECK(severity) && cxxlog::Logger(severity).at(CXXLOG_LOCATION)
+
+/// @brief Argument of cxxlog::Logger::at() describing the call site
+///
+/// The descriptor is a `static constexpr` object of the call site, so
+/// neither the file name nor the line is processed at runtime. The name of
+/// the function is taken by a default argument of at(), so the macros can
+/// also be used outside of functions.
+/// @see cxxlog::col::location
+#define CXXLOG_LOCATION \
+  []() -> const cxxlog::source_location& { \
+    static constexpr cxxlog::source_location location( \
+        __FILE__ ":" CXXLOG_STRINGIFY(__LINE__), \
+        sizeof(__FILE__ ":" CXXLOG_STRINGIFY(__LINE__)) - 1, __LINE__); \
+    return location; \
+  }()
+
+/// @brief Name of the function calling a function whose default argument
+/// this is, or an empty string if the compiler cannot tell
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_FUNCTION)
+#define CXXLOG_CALLER_FUNCTION __builtin_FUNCTION()
+#endif
+#elif defined(__GNUC__) && !defined(__clang__)
+#define CXXLOG_CALLER_FUNCTION __builtin_FUNCTION()
+#elif defined(_MSC_VER) && _MSC_VER >= 1926
+#define CXXLOG_CALLER_FUNCTION __builtin_FUNCTION()
+#endif
+#ifndef CXXLOG_CALLER_FUNCTION
+#define CXXLOG_CALLER_FUNCTION ""
+#endif  // CXXLOG_CALLER_FUNCTION
+
+#define CXXLOG_STRINGIFY(x) CXXLOG_STRINGIFY_(x)
+#define CXXLOG_STRINGIFY_(x) #x
+
+/// @brief Macro that additionally checks the level of a category
+/// @code {.cxx}
+/// cxxlog::category network(cxxlog::warning);
+/// CXXLOG_C(network, cxxlog::info) << "filtered by the category";
+/// @endcode
+/// @see cxxlog::category
+#define CXXLOG_C(category, severity) \
+  CXXLOG_CHECK(severity) && (category).enabled(severity) && \
+  cxxlog::Logger(severity).at(CXXLOG_LOCATION)
+
+/// @brief Macro that writes a log through a channel
+///
+/// The record uses the destinations and columns of the channel and is
+/// filtered by its level.
+/// @code {.cxx}
+/// cxxlog::channel network(std::cerr);
+/// CXXLOG_CH(network, cxxlog::info) << "preconfigured";
+/// @endcode
+/// @see cxxlog::channel
+#define CXXLOG_CH(channel, severity) \
+  CXXLOG_CHECK(severity) && (channel).enabled(severity) && \
+  cxxlog::Logger(severity, channel).at(CXXLOG_LOCATION)
+
+/// @brief Macro that writes a log through a rate-limited call site
+///
+/// `site` is one of the cxxlog::rate sites, created once per call site. A
+/// suppressed record costs the level check and one relaxed atomic operation;
+/// the number of records suppressed since the previous one is appended to
+/// the next record written from the same site.
+/// @see CXXLOG_EVERY_N, CXXLOG_FIRST_N, CXXLOG_EVERY_MS, CXXLOG_SAMPLE
+#define CXXLOG_LIMIT(severity, site, limit) \
+  CXXLOG_CHECK(severity) && cxxlog::detail::admit( \
+      []() -> site& { static site instance; return instance; }(), limit) && \
+  cxxlog::Logger(severity).at(CXXLOG_LOCATION) \
+      .suppressed(cxxlog::detail::last_suppressed())
+
+/// @brief Macro that writes every n-th record of the call site
+/// @code {.cxx}
+/// for (const auto &packet : packets) {
+///   CXXLOG_EVERY_N(cxxlog::info, 1000) << "packet " << packet.id;
+/// }
+/// @endcode
+#define CXXLOG_EVERY_N(severity, n) \
+  CXXLOG_LIMIT(severity, cxxlog::rate::every_n, n)
+
+/// @brief Macro that writes only the first n records of the call site
+/// @code {.cxx}
+/// CXXLOG_FIRST_N(cxxlog::warning, 10) << "deprecated option";
+/// @endcode
+#define CXXLOG_FIRST_N(severity, n) \
+  CXXLOG_LIMIT(severity, cxxlog::rate::first_n, n)
+
+/// @brief Macro that writes at most one record per interval
+/// @code {.cxx}
+/// CXXLOG_EVERY_MS(cxxlog::warning, 1000) << "queue is full";
+/// @endcode
+#define CXXLOG_EVERY_MS(severity, milliseconds) \
+  CXXLOG_LIMIT(severity, cxxlog::rate::every_ms, milliseconds)
+
+/// @brief Macro that writes each record with a probability
+/// @code {.cxx}
+/// CXXLOG_SAMPLE(cxxlog::debug, 0.01) << "about 1% of the requests";
+/// @endcode
+#define CXXLOG_SAMPLE(severity, probability) \
+  CXXLOG_LIMIT(severity, cxxlog::rate::sample, probability)
+
+/// @brief Expansion of a log macro stripped by CXXLOG_STRIP_BELOW
+/// @see cxxlog::detail::stripped_logger
+#define CXXLOG_STRIPPED while (false) cxxlog::detail::stripped_logger()
 
 /// @brief Macro for fatal log
+///
+/// The statement returns after the record and everything logged before it
+/// has been written, buffered sinks included.
 /// @code {.cxx}
 /// CXXLOG_F << "fatal log";
 /// @endcode
+#if CXXLOG_STRIP_BELOW >= 1
 #define CXXLOG_F CXXLOG(cxxlog::fatal)
+#else
+#define CXXLOG_F CXXLOG_STRIPPED
+#endif
 
 /// @brief Macro for error log
 /// @code {.cxx}
 /// CXXLOG_E << "error log";
 /// @endcode
+#if CXXLOG_STRIP_BELOW >= 2
 #define CXXLOG_E CXXLOG(cxxlog::error)
+#else
+#define CXXLOG_E CXXLOG_STRIPPED
+#endif
 
 /// @brief Macro for warning log
 /// @code {.cxx}
 /// CXXLOG_W << "warning log";
 /// @endcode
+#if CXXLOG_STRIP_BELOW >= 3
 #define CXXLOG_W CXXLOG(cxxlog::warning)
+#else
+#define CXXLOG_W CXXLOG_STRIPPED
+#endif
 
 /// @brief Macro for information log
 /// @code {.cxx}
 /// CXXLOG_I << "information log";
 /// @endcode
+#if CXXLOG_STRIP_BELOW >= 4
 #define CXXLOG_I CXXLOG(cxxlog::info)
+#else
+#define CXXLOG_I CXXLOG_STRIPPED
+#endif
 
 /// @brief Macro for debug log
 /// @code {.cxx}
 /// CXXLOG_D << "debug log";
 /// @endcode
+#if CXXLOG_STRIP_BELOW >= 5
 #define CXXLOG_D CXXLOG(cxxlog::debug)
+#else
+#define CXXLOG_D CXXLOG_STRIPPED
+#endif
 
 /// @brief Macro for verbose log
 /// @code {.cxx}
 /// CXXLOG_V << "verbose log";
 /// @endcode
+#if CXXLOG_STRIP_BELOW >= 6
 #define CXXLOG_V CXXLOG(cxxlog::verbose)
+#else
+#define CXXLOG_V CXXLOG_STRIPPED
+#endif
+
+/// @brief Macro for fatal log through a channel
+#if CXXLOG_STRIP_BELOW >= 1
+#define CXXLOG_CH_F(channel) CXXLOG_CH(channel, cxxlog::fatal)
+#else
+#define CXXLOG_CH_F(channel) CXXLOG_STRIPPED
+#endif
+
+/// @brief Macro for error log through a channel
+#if CXXLOG_STRIP_BELOW >= 2
+#define CXXLOG_CH_E(channel) CXXLOG_CH(channel, cxxlog::error)
+#else
+#define CXXLOG_CH_E(channel) CXXLOG_STRIPPED
+#endif
+
+/// @brief Macro for warning log through a channel
+#if CXXLOG_STRIP_BELOW >= 3
+#define CXXLOG_CH_W(channel) CXXLOG_CH(channel, cxxlog::warning)
+#else
+#define CXXLOG_CH_W(channel) CXXLOG_STRIPPED
+#endif
+
+/// @brief Macro for information log through a channel
+#if CXXLOG_STRIP_BELOW >= 4
+#define CXXLOG_CH_I(channel) CXXLOG_CH(channel, cxxlog::info)
+#else
+#define CXXLOG_CH_I(channel) CXXLOG_STRIPPED
+#endif
+
+/// @brief Macro for debug log through a channel
+#if CXXLOG_STRIP_BELOW >= 5
+#define CXXLOG_CH_D(channel) CXXLOG_CH(channel, cxxlog::debug)
+#else
+#define CXXLOG_CH_D(channel) CXXLOG_STRIPPED
+#endif
+
+/// @brief Macro for verbose log through a channel
+#if CXXLOG_STRIP_BELOW >= 6
+#define CXXLOG_CH_V(channel) CXXLOG_CH(channel, cxxlog::verbose)
+#else
+#define CXXLOG_CH_V(channel) CXXLOG_STRIPPED
+#endif
 
 /// @brief Namespace of cxxlog
 namespace cxxlog {
@@ -112,184 +387,2855 @@ enum severity_t {
   verbose = 6,
 };
 
-/// @brief Namespace of cxxlog column
-namespace col {
+namespace detail {
 
-/// @brief Arguments for column function
-struct arguments {
-  std::ostream &out;
-  severity_t severity;
+/// @brief Holder of the runtime log level
+///
+/// A static member of a class template is constant-initialized and can be
+/// defined in a header, so reading it needs no initialization guard.
+template<typename T = void>
+struct runtime_level {
+  static std::atomic<int> value;
 };
 
-/// @brief Alias for column function
-using Function = std::function<void (const arguments &)>;
+template<typename T>
+std::atomic<int> runtime_level<T>::value(verbose);
 
-/// @brief Column of time
-struct time {
-  void operator()(const arguments &args) {
-    const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
-    args.out << std::setw(10) << (usec / 1000000) << '.'
-        << std::setw(6) << std::setfill('0') << (usec % 1000000);
+}  // namespace detail
+
+/// @brief Sets the runtime log level
+///
+/// Records are output only if their severity passes both @ref CXXLOG_LEVEL
+/// and the runtime level. The default runtime level is cxxlog::verbose.
+/// @code {.cxx}
+/// cxxlog::set_level(cxxlog::debug);
+/// @endcode
+/// @param[in] level - log level
+inline void set_level(severity_t level) {
+  detail::runtime_level<>::value.store(level, std::memory_order_relaxed);
+}
+
+/// @brief Gets the runtime log level
+inline severity_t get_level() {
+  return static_cast<severity_t>(
+      detail::runtime_level<>::value.load(std::memory_order_relaxed));
+}
+
+/// @brief Checks the severity against the runtime log level
+inline bool enabled(severity_t severity) {
+  return detail::runtime_level<>::value.load(std::memory_order_relaxed) >=
+      severity;
+}
+
+/// @brief Category of logs with its own runtime log level
+/// @see CXXLOG_C
+class category {
+ public:
+  /// @brief Constructor
+  /// @param[in] level - initial log level of the category
+  explicit category(severity_t level = verbose) : level_(level) {
+  }
+
+  category(const category&) = delete;
+  category& operator=(const category&) = delete;
+
+  /// @brief Sets the log level of the category
+  void set_level(severity_t level) {
+    level_.store(level, std::memory_order_relaxed);
+  }
+
+  /// @brief Gets the log level of the category
+  severity_t level() const {
+    return static_cast<severity_t>(level_.load(std::memory_order_relaxed));
+  }
+
+  /// @brief Checks the severity against the level of the category
+  bool enabled(severity_t severity) const {
+    return level_.load(std::memory_order_relaxed) >= severity;
   }
+
+ private:
+  std::atomic<int> level_;
 };
 
-/// @brief Column of severity
-struct severity {
-  void operator()(const arguments &args) {
-    const char *severity_string[] = {
-        "     ",  // none
-        "FATAL",  // fatal
-        "ERROR",  // error
-        "WARN ",  // warning
-        "INFO ",  // info
-        "DEBUG",  // debug
-        "VERB ",  // verbose
-    };
-    args.out << severity_string[args.severity];
+/// @brief Namespace of the call sites of rate-limited logs
+/// @see CXXLOG_LIMIT
+namespace rate {
+
+/// @brief Admits every n-th record
+class every_n {
+ public:
+  constexpr every_n() : count_(0) {
+  }
+
+  /// @return 0 to suppress the record, or 1 + the number suppressed
+  std::uint64_t admit(std::uint64_t n) {
+    const auto count = count_.fetch_add(1, std::memory_order_relaxed);
+    if (n <= 1) {
+      return 1;
+    }
+    if (count % n != 0) {
+      return 0;
+    }
+    return (count == 0) ? 1 : n;
   }
+
+ private:
+  std::atomic<std::uint64_t> count_;
 };
 
-}  // namespace col
+/// @brief Admits the first n records
+class first_n {
+ public:
+  constexpr first_n() : count_(0) {
+  }
+
+  /// @return 0 to suppress the record, or 1
+  std::uint64_t admit(std::uint64_t n) {
+    if (count_.load(std::memory_order_relaxed) >= n) {
+      return 0;
+    }
+    return (count_.fetch_add(1, std::memory_order_relaxed) < n) ? 1 : 0;
+  }
+
+ private:
+  std::atomic<std::uint64_t> count_;
+};
+
+/// @brief Admits at most one record per interval
+class every_ms {
+ public:
+  constexpr every_ms() : next_(0), suppressed_(0) {
+  }
+
+  /// @return 0 to suppress the record, or 1 + the number suppressed
+  std::uint64_t admit(std::int64_t milliseconds) {
+    using namespace std::chrono;
+    const auto now = duration_cast<microseconds>(
+        steady_clock::now().time_since_epoch()).count();
+    auto next = next_.load(std::memory_order_relaxed);
+    if (now < next || !next_.compare_exchange_strong(
+        next, now + milliseconds * 1000, std::memory_order_relaxed)) {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    return 1 + suppressed_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::int64_t> next_;
+  std::atomic<std::uint64_t> suppressed_;
+};
+
+/// @brief Admits each record with a probability
+///
+/// The random numbers come from a thread-local generator, so only
+/// suppressed records touch the shared counter.
+class sample {
+ public:
+  constexpr sample() : suppressed_(0) {
+  }
+
+  /// @return 0 to suppress the record, or 1 + the number suppressed
+  std::uint64_t admit(double probability) {
+    // 2^-53: the resolution of the uniform random number
+    const double unit = 1.0 / 9007199254740992.0;
+    if (static_cast<double>(random() >> 11) * unit >= probability) {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    return 1 + suppressed_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  /// @brief xorshift64* seeded from the address of the thread's state
+  static std::uint64_t random() {
+    static thread_local std::uint64_t state = 0;
+    if (state == 0) {
+      state = reinterpret_cast<std::uintptr_t>(&state) |
+          0x9e3779b97f4a7c15ull;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+  }
+
+  std::atomic<std::uint64_t> suppressed_;
+};
+
+}  // namespace rate
 
 namespace detail {
 
-inline std::mutex& get_mutex() {
-  static std::mutex _mutex;
-  return _mutex;
+/// @brief Number of records suppressed before the one just admitted
+inline std::uint64_t& last_suppressed() {
+  static thread_local std::uint64_t count = 0;
+  return count;
 }
 
-template<typename T>
-T* to_ptr(T &obj) {
-  return &obj;
+/// @brief Asks a rate-limited call site whether to write a record
+template<typename Site, typename Limit>
+bool admit(Site &site, Limit limit) {
+  const auto ticket = site.admit(limit);
+  if (ticket == 0) {
+    return false;
+  }
+  last_suppressed() = ticket - 1;
+  return true;
 }
 
-template<typename T>
-T* to_ptr(T *obj) {
-  return obj;
-}
+}  // namespace detail
 
-inline std::nullptr_t to_ptr(std::nullptr_t) {
-  return nullptr;
+namespace detail {
+
+constexpr bool is_separator(char ch) {
+  return ch == '/' || ch == '\\';
 }
 
-inline void add_streams(std::vector<std::ostream*>*) {
+constexpr std::size_t prefer(std::size_t right, std::size_t left) {
+  return (right != 0) ? right : left;
 }
 
-template<typename Stream, typename... Args>
-void add_streams(
-    std::vector<std::ostream*> *streams, Stream &&stream, Args &&...args) {
-  auto stream_ptr = to_ptr(std::forward<Stream>(stream));
-  if (stream_ptr != nullptr) {
-    streams->push_back(stream_ptr);
-  }
-  add_streams(streams, std::forward<Args>(args)...);
+/// @brief Index after the last path separator in `[begin, end)`, or 0
+///
+/// Halves the range at each step, so the recursion depth of the constant
+/// evaluation is logarithmic in the length of the path.
+constexpr std::size_t basename_offset(
+    const char *path, std::size_t begin, std::size_t end) {
+  return (end - begin == 0) ? 0 :
+      (end - begin == 1) ? (is_separator(path[begin]) ? begin + 1 : 0) :
+      prefer(basename_offset(path, begin + (end - begin) / 2, end),
+          basename_offset(path, begin, begin + (end - begin) / 2));
 }
 
 }  // namespace detail
 
-/// @brief A simple logger that wraps the output stream
-class Logger {
- public:
+/// @brief Source location of a call site
+/// @see CXXLOG_LOCATION
+struct source_location {
   /// @brief Constructor
-  /// @param[in] severity - log severity
-  explicit Logger(severity_t severity)
-      : severity_(severity),
-        buffer_(),
-        streams_({ &std::cout }),
-        columns_({ col::time(), col::severity() }) {
+  /// @param[in] location - `path:line`
+  /// @param[in] size - length of `location`
+  /// @param[in] line - line number
+  constexpr source_location(
+      const char *location, std::size_t size, std::uint32_t line)
+      : text(location + detail::basename_offset(location, 0, size)),
+        size(size - detail::basename_offset(location, 0, size)),
+        line(line) {
   }
 
-  /// @brief Destructor
-  ///
-  /// If data is inserted, flush it.
-  ~Logger() {
-    if (!streams_.empty() && (buffer_.tellp() != 0)) {
-      buffer_ << std::endl;
-      const auto str = buffer_.str();
-      std::lock_guard<std::mutex> lock(detail::get_mutex());
-      for (auto out : streams_) {
-        *out << str;
-      }
-    }
+  /// @brief `file:line` without the directories, not null-terminated
+  const char *text;
+  /// @brief Length of `text`
+  std::size_t size;
+  /// @brief Line number
+  std::uint32_t line;
+};
+
+/// @brief Wall clock time split into seconds and microseconds
+struct timestamp {
+  std::int64_t seconds;
+  std::uint32_t microseconds;
+
+  /// @brief Microseconds since the epoch
+  std::int64_t to_microseconds() const {
+    return seconds * 1000000 + microseconds;
   }
+};
 
-  /// @brief Specifies the output streams
-  ///
-  /// Examples:
-  /// @code {.cxx}
-  /// CXXLOG_E(std::cerr) << "standard error ref";
-  /// CXXLOG_E(&std::cerr) << "standard error ptr";
-  ///
-  /// std::ofstream fs("log.txt");
-  /// CXXLOG_E(&fs) << "file stream";
-  ///
-  /// CXXLOG_E(std::cerr, fs) << "multiple outputs";
-  /// @endcode
-  /// @param[in] output_streams - output streams
-  template<typename... OutputStreams>
-  Logger& operator()(OutputStreams &&...output_streams) {
-    std::vector<std::ostream*> streams;
-    detail::add_streams(
-        &streams, std::forward<OutputStreams>(output_streams)...);
-    streams_.swap(streams);
-    return *this;
+namespace detail {
+
+/// @brief Writes a decimal number padded to `width` with `fill`
+/// @return end of the written characters
+inline char* format_uint(
+    char *out, std::uint64_t value, int width, char fill = '0') {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+  for (int i = count; i < width; ++i) {
+    *out++ = fill;
+  }
+  while (count > 0) {
+    *out++ = digits[--count];
   }
+  return out;
+}
 
-  Logger& operator()() {
-    return *this;
+/// @brief Calendar time of a second, in UTC or local time
+inline bool to_calendar(std::int64_t seconds, bool local, std::tm *tm) {
+  const auto t = static_cast<std::time_t>(seconds);
+#if defined(_WIN32)
+  return (local ? localtime_s(tm, &t) : gmtime_s(tm, &t)) == 0;
+#else
+  return (local ? localtime_r(&t, tm) : gmtime_r(&t, tm)) != nullptr;
+#endif
+}
+
+/// @brief Small number identifying the calling thread, starting from 1
+inline std::uint32_t thread_index() {
+  static std::atomic<std::uint32_t> next(0);
+  static thread_local const std::uint32_t index =
+      next.fetch_add(1, std::memory_order_relaxed) + 1;
+  return index;
+}
+
+/// @brief Fixed width (5 characters) name of a severity
+inline const char* severity_string(severity_t severity) {
+  static const char *const strings[] = {
+      "     ",  // none
+      "FATAL",  // fatal
+      "ERROR",  // error
+      "WARN ",  // warning
+      "INFO ",  // info
+      "DEBUG",  // debug
+      "VERB ",  // verbose
+  };
+  return strings[severity];
+}
+
+/// @brief Per-thread text of the last formatted second
+struct second_cache {
+  std::int64_t seconds;
+  std::size_t size;
+  char text[32];
+};
+
+/// @brief Per-thread text of col::thread and col::thread_prefix
+struct thread_text {
+  std::string id;
+  std::string prefix;
+};
+
+/// @brief Formats the id of the calling thread in hexadecimal
+CXXLOG_API std::string thread_id_text();
+
+/// @brief Stream written by loggers without destinations
+CXXLOG_API std::ostream* standard_output();
+
+/// @brief Text of the calling thread, formatted on first use
+inline thread_text& this_thread_text() {
+  static thread_local thread_text text;
+  if (text.id.empty()) {
+    text.id = thread_id_text();
   }
+  return text;
+}
 
-  /// @brief Specifies the columns
-  ///
-  /// Examples:
-  /// @code {.cxx}
-  /// CXXLOG_E.cols() << "no columns";
-  /// CXXLOG_E.cols(cxxlog::col::time()) << "time column only";
-  /// CXXLOG_E.cols(cxxlog::col::severity(), cxxlog::col::time())
-  ///     << "multiple columns";
-  /// @endcode
-  /// @param[in] functions - column funcions
-  template<typename... ColumnFunctions>
-  Logger& cols(ColumnFunctions &&...functions) {
-    if (buffer_.tellp() == 0) {
-      std::vector<col::Function> columns { functions... };
-      columns_.swap(columns);
+/// @brief Identifier of the process, read once
+inline const std::string& process_id_text() {
+#if defined(_WIN32)
+  static const std::string text = std::to_string(_getpid());
+#else
+  static const std::string text = std::to_string(::getpid());
+#endif
+  return text;
+}
+
+}  // namespace detail
+
+/// @brief Namespace of cxxlog column
+namespace col {
+
+/// @brief Arguments for column function
+struct arguments {
+  std::ostream &out;
+  severity_t severity;
+  /// @brief Time of the record, read from col::precise_clock
+  timestamp time;
+  /// @brief Call site of the record, or nullptr
+  const source_location *location;
+  /// @brief Name of the calling function, or nullptr
+  const char *function;
+  std::size_t function_size;
+};
+
+/// @brief Alias for column function
+using Function = std::function<void (const arguments &)>;
+
+/// @brief Clock with microsecond precision
+struct precise_clock {
+  /// @brief Number of fractional digits
+  static constexpr int digits = 6;
+
+  static timestamp now() {
+    const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return { static_cast<std::int64_t>(usec / 1000000),
+             static_cast<std::uint32_t>(usec % 1000000) };
+  }
+
+  /// @brief Time of the record being formatted
+  static timestamp now(const arguments &args) {
+    return args.time;
+  }
+};
+
+/// @brief Cheaper clock with millisecond precision
+///
+/// Uses `CLOCK_REALTIME_COARSE` where available, which is read without a
+/// system call but only advances once per scheduler tick.
+struct coarse_clock {
+  /// @brief Number of fractional digits
+  static constexpr int digits = 3;
+
+  static timestamp now() {
+#if defined(CLOCK_REALTIME_COARSE)
+    timespec ts;
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0) {
+      return { static_cast<std::int64_t>(ts.tv_sec),
+               static_cast<std::uint32_t>(ts.tv_nsec / 1000) };
     }
-    return *this;
+#endif  // CLOCK_REALTIME_COARSE
+    return precise_clock::now();
   }
 
-  /// @brief Inserts data into the output stream
-  /// @param[in] value - value to insert
-  template<typename T>
-  Logger& operator<<(T &&value) {
-    if (!streams_.empty()) {
-      if ((buffer_.tellp() == 0) && !columns_.empty()) {
-        const auto flags = buffer_.flags();
-        for (const auto &column : columns_) {
-          column({ buffer_, severity_ });
-          buffer_.flags(flags);
-          buffer_ << ' ';
-        }
-      }
-      buffer_ << std::forward<T>(value);
+  static timestamp now(const arguments&) {
+    return now();
+  }
+};
+
+/// @brief Base of time columns that cache the text of the current second
+///
+/// `Format::format_seconds()` renders the seconds part only when the second
+/// changes; the fraction is appended for each record.
+template<typename Format, typename Clock>
+struct cached_time {
+  void operator()(const arguments &args) {
+    static thread_local detail::second_cache cache = { -1, 0, {} };
+    const auto now = Clock::now(args);
+    if (now.seconds != cache.seconds) {
+      cache.size = static_cast<std::size_t>(
+          Format::format_seconds(now.seconds, cache.text) - cache.text);
+      cache.seconds = now.seconds;
     }
-    return *this;
+    static_assert(Clock::digits == 3 || Clock::digits == 6, "digits");
+    char text[sizeof(cache.text) + 8];
+    std::memcpy(text, cache.text, cache.size);
+    auto end = text + cache.size;
+    *end++ = '.';
+    end = detail::format_uint(end,
+        (Clock::digits == 3) ? (now.microseconds / 1000) : now.microseconds,
+        Clock::digits);
+    end = Format::format_suffix(end);
+    args.out.write(text, end - text);
   }
+};
 
-  /// @brief boolean conversion for short-circuit evaluation
-  /// @see CXXLOG
-  explicit operator bool() const {
-    return true;
+/// @brief Column of epoch time (`1647540198.640983`)
+template<typename Clock>
+struct basic_time : cached_time<basic_time<Clock>, Clock> {
+  static char* format_seconds(std::int64_t seconds, char *out) {
+    return detail::format_uint(
+        out, static_cast<std::uint64_t>(seconds), 10, ' ');
   }
 
- private:
-  const severity_t severity_;
-  std::ostringstream buffer_;
-  std::vector<std::ostream*> streams_;
-  std::vector<col::Function> columns_;
+  static char* format_suffix(char *out) {
+    return out;
+  }
 };
 
+/// @brief Column of ISO 8601 time in UTC (`2022-03-17T18:03:18.640983Z`)
+template<typename Clock>
+struct basic_iso8601 : cached_time<basic_iso8601<Clock>, Clock> {
+  static char* format_seconds(std::int64_t seconds, char *out) {
+    return format_calendar(seconds, false, 'T', out);
+  }
+
+  static char* format_suffix(char *out) {
+    *out++ = 'Z';
+    return out;
+  }
+
+  /// @brief Writes `YYYY-MM-DD<separator>hh:mm:ss`
+  static char* format_calendar(
+      std::int64_t seconds, bool local, char separator, char *out) {
+    std::tm tm {};
+    detail::to_calendar(seconds, local, &tm);
+    out = detail::format_uint(out, tm.tm_year + 1900, 4);
+    *out++ = '-';
+    out = detail::format_uint(out, tm.tm_mon + 1, 2);
+    *out++ = '-';
+    out = detail::format_uint(out, tm.tm_mday, 2);
+    *out++ = separator;
+    out = detail::format_uint(out, tm.tm_hour, 2);
+    *out++ = ':';
+    out = detail::format_uint(out, tm.tm_min, 2);
+    *out++ = ':';
+    return detail::format_uint(out, tm.tm_sec, 2);
+  }
+};
+
+/// @brief Column of local time (`2022-03-18 03:03:18.640983`)
+template<typename Clock>
+struct basic_local_time : cached_time<basic_local_time<Clock>, Clock> {
+  static char* format_seconds(std::int64_t seconds, char *out) {
+    return basic_iso8601<Clock>::format_calendar(seconds, true, ' ', out);
+  }
+
+  static char* format_suffix(char *out) {
+    return out;
+  }
+};
+
+/// @brief Column of time
+using time = basic_time<precise_clock>;
+
+/// @brief Column of time read from the coarse clock (`1647540198.640`)
+using coarse_time = basic_time<coarse_clock>;
+
+/// @brief Column of ISO 8601 time in UTC
+using iso8601 = basic_iso8601<precise_clock>;
+
+/// @brief Column of local time
+using local_time = basic_local_time<precise_clock>;
+
+/// @brief Column of severity
+struct severity {
+  void operator()(const arguments &args) {
+    args.out.write(detail::severity_string(args.severity), 5);
+  }
+};
+
+/// @brief Column of the call site (`main.cxx:42`)
+///
+/// Copies the text prepared at compile time by CXXLOG_LOCATION.
+struct location {
+  void operator()(const arguments &args) {
+    if (args.location != nullptr) {
+      args.out.write(args.location->text,
+          static_cast<std::streamsize>(args.location->size));
+    }
+  }
+};
+
+/// @brief Column of the calling function (`main`)
+struct function_name {
+  void operator()(const arguments &args) {
+    if (args.function != nullptr) {
+      args.out.write(
+          args.function, static_cast<std::streamsize>(args.function_size));
+    }
+  }
+};
+
+/// @brief Column of the thread name or id (`7f3a2c1ff740`)
+///
+/// The id is formatted once per thread; cxxlog::set_thread_name() replaces
+/// it by a name.
+struct thread {
+  void operator()(const arguments &args) {
+    const auto &text = detail::this_thread_text().id;
+    args.out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  }
+};
+
+/// @brief Column of the process id (`12345`)
+struct process_id {
+  void operator()(const arguments &args) {
+    const auto &text = detail::process_id_text();
+    args.out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  }
+};
+
+/// @brief Column of the text set by cxxlog::set_thread_prefix()
+///
+/// Copies the per-thread text prepared beforehand, so the static part of a
+/// line costs one copy per record.
+struct thread_prefix {
+  void operator()(const arguments &args) {
+    const auto &text = detail::this_thread_text().prefix;
+    args.out.write(text.data(), static_cast<std::streamsize>(text.size()));
+  }
+};
+
+}  // namespace col
+
+/// @brief Type of a structured field
+/// @see cxxlog::Logger::kv
+enum class field_type : std::uint8_t {
+  boolean, integer, unsigned_integer, floating, string,
+};
+
+/// @brief Structured field of a record
+/// @see cxxlog::for_each_field
+struct field {
+  field_type type;
+  const char *key;
+  std::size_t key_size;
+  union {
+    bool boolean;
+    std::int64_t integer;
+    std::uint64_t unsigned_integer;
+    double floating;
+  };
+  /// @brief Value of a string field
+  const char *text;
+  std::size_t text_size;
+};
+
+/// @brief Finished record passed to sinks
+struct record {
+  /// @brief Constructor
+  ///
+  /// By default the whole line but the trailing newline is the message and
+  /// the record has no fields.
+  record(severity_t severity, const char *data, std::size_t size,
+      timestamp time, std::size_t message_offset = 0,
+      std::size_t message_size = npos, const char *fields = nullptr,
+      std::size_t fields_size = 0)
+      : severity(severity), data(data), size(size), time(time),
+        message_offset(message_offset),
+        message_size((message_size != npos) ? message_size :
+            line_size(data, size) - message_offset),
+        fields(fields), fields_size(fields_size) {
+  }
+
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  /// @brief Severity of the record
+  severity_t severity;
+  /// @brief Formatted line including the columns and the trailing newline
+  const char *data;
+  /// @brief Number of bytes of `data`
+  std::size_t size;
+  /// @brief Time of the record, read from col::precise_clock
+  timestamp time;
+  /// @brief Offset of the message in `data`, after the columns
+  std::size_t message_offset;
+  /// @brief Size of the message, without the fields rendered as text
+  std::size_t message_size;
+  /// @brief Encoded structured fields, read by cxxlog::for_each_field
+  const char *fields;
+  /// @brief Number of bytes of `fields`
+  std::size_t fields_size;
+
+ private:
+  static std::size_t line_size(const char *data, std::size_t size) {
+    return (size > 0 && data[size - 1] == '\n') ? size - 1 : size;
+  }
+};
+
+/// @brief Immutable, reference-counted copy of a record
+///
+/// A record fanned out to several sinks that take shared records (see
+/// cxxlog::sink::shared()) is copied once, and every sink holds a reference
+/// to the same buffer for as long as it needs it.
+class shared_record {
+ public:
+  shared_record() : block_(nullptr) {
+  }
+
+  /// @brief Copies the text and the fields of a record
+  explicit shared_record(const record &r) : block_(allocate(r)) {
+  }
+
+  shared_record(const shared_record &other) : block_(other.block_) {
+    if (block_ != nullptr) {
+      block_->references.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  shared_record(shared_record &&other) noexcept : block_(other.block_) {
+    other.block_ = nullptr;
+  }
+
+  shared_record& operator=(shared_record other) noexcept {
+    std::swap(block_, other.block_);
+    return *this;
+  }
+
+  ~shared_record() {
+    if (block_ != nullptr &&
+        block_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      block_->~block();
+      ::operator delete(block_);
+    }
+  }
+
+  explicit operator bool() const {
+    return block_ != nullptr;
+  }
+
+  /// @brief The record, valid while this reference is held
+  record view() const {
+    const auto text = reinterpret_cast<const char*>(block_ + 1);
+    return { block_->severity, text, block_->size, block_->time,
+        block_->message_offset, block_->message_size, text + block_->size,
+        block_->fields_size };
+  }
+
+ private:
+  struct block {
+    std::atomic<std::size_t> references;
+    severity_t severity;
+    timestamp time;
+    std::size_t size;
+    std::size_t message_offset;
+    std::size_t message_size;
+    std::size_t fields_size;
+  };
+
+  static block* allocate(const record &r) {
+    const auto memory =
+        ::operator new(sizeof(block) + r.size + r.fields_size);
+    const auto b = new (memory) block;
+    b->references.store(1, std::memory_order_relaxed);
+    b->severity = r.severity;
+    b->time = r.time;
+    b->size = r.size;
+    b->message_offset = r.message_offset;
+    b->message_size = r.message_size;
+    b->fields_size = r.fields_size;
+    const auto text = reinterpret_cast<char*>(b + 1);
+    std::memcpy(text, r.data, r.size);
+    if (r.fields_size != 0) {
+      std::memcpy(text + r.size, r.fields, r.fields_size);
+    }
+    return b;
+  }
+
+  block *block_;
+};
+
+/// @brief Calls a function for each structured field of a record
+///
+/// Encoded fields are a byte sequence of `u8 type, u8 key size, key, value`
+/// where integers and doubles are stored in the byte order of the machine
+/// and strings as `u32 size, bytes`.
+/// @code {.cxx}
+/// cxxlog::for_each_field(r, [](const cxxlog::field &f) { ... });
+/// @endcode
+template<typename Function>
+void for_each_field(const record &r, Function &&function) {
+  auto p = r.fields;
+  const auto end = r.fields + r.fields_size;
+  while (p != nullptr && end - p >= 2) {
+    field f;
+    f.type = static_cast<field_type>(static_cast<std::uint8_t>(p[0]));
+    f.key_size = static_cast<std::uint8_t>(p[1]);
+    f.key = p + 2;
+    f.text = nullptr;
+    f.text_size = 0;
+    p += 2 + f.key_size;
+    switch (f.type) {
+      case field_type::boolean:
+        f.boolean = (*p++ != 0);
+        break;
+      case field_type::integer:
+        std::memcpy(&f.integer, p, sizeof(f.integer));
+        p += sizeof(f.integer);
+        break;
+      case field_type::unsigned_integer:
+        std::memcpy(&f.unsigned_integer, p, sizeof(f.unsigned_integer));
+        p += sizeof(f.unsigned_integer);
+        break;
+      case field_type::floating:
+        std::memcpy(&f.floating, p, sizeof(f.floating));
+        p += sizeof(f.floating);
+        break;
+      case field_type::string: {
+        std::uint32_t size;
+        std::memcpy(&size, p, sizeof(size));
+        f.text = p + sizeof(size);
+        f.text_size = size;
+        p += sizeof(size) + size;
+        break;
+      }
+    }
+    function(static_cast<const field&>(f));
+  }
+}
+
+/// @brief Destination of records other than an output stream
+///
+/// Sinks are specified like output streams. `write()` may be called from
+/// several threads at once, so each sink synchronizes itself and must not
+/// interleave records.
+/// @code {.cxx}
+/// cxxlog::file_sink file("log.txt");
+/// CXXLOG_E(file, std::cerr) << "sink and stream";
+/// @endcode
+namespace detail {
+struct sink_stats;
+}  // namespace detail
+
+class sink {
+ public:
+  sink() : bytes_written_(0), level_(verbose) {
+  }
+
+  sink(const sink &other) : bytes_written_(0), level_(other.level()) {
+  }
+
+  sink& operator=(const sink &other) {
+    set_level(other.level());
+    return *this;
+  }
+
+  virtual ~sink() = default;
+
+  /// @brief Writes a record
+  virtual void write(const record &r) = 0;
+
+  /// @brief Writes buffered records, if any
+  virtual void flush() {
+  }
+
+  /// @brief Whether the sink encodes the fields of records itself
+  ///
+  /// If every destination of a record is structured, its fields are not
+  /// rendered into the text of the line.
+  virtual bool structured() const {
+    return false;
+  }
+
+  /// @brief Whether the sink takes records through write_shared()
+  ///
+  /// Such sinks keep records beyond the call, typically to write them on
+  /// their own thread. A record fanned out to several of them is copied
+  /// once into a cxxlog::shared_record.
+  virtual bool shared() const {
+    return false;
+  }
+
+  /// @brief Writes a record, called instead of write() if shared() is true
+  virtual void write_shared(const shared_record &r) {
+    write(r.view());
+  }
+
+  /// @brief Bytes of the records handed to write()
+  /// @see CXXLOG_STATS
+  std::uint64_t bytes_written() const {
+    return bytes_written_.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Sets the log level of the sink
+  ///
+  /// A record is written only to the destinations that accept its
+  /// severity. When no destination accepts it, the columns, the inserted
+  /// values and the fields are not formatted at all.
+  /// @code {.cxx}
+  /// cxxlog::file_sink trace("trace.txt");
+  /// trace.set_level(cxxlog::info);
+  /// CXXLOG_D(trace) << "not formatted";
+  /// CXXLOG_D(trace, std::cerr) << "formatted once for std::cerr";
+  /// @endcode
+  void set_level(severity_t level) {
+    level_.store(level, std::memory_order_relaxed);
+  }
+
+  /// @brief Gets the log level of the sink
+  severity_t level() const {
+    return static_cast<severity_t>(level_.load(std::memory_order_relaxed));
+  }
+
+  /// @brief Checks the severity against the level of the sink
+  bool enabled(severity_t severity) const {
+    return level_.load(std::memory_order_relaxed) >= severity;
+  }
+
+ private:
+  friend struct detail::sink_stats;
+
+  std::atomic<std::uint64_t> bytes_written_;
+  std::atomic<int> level_;
+};
+
+/// @brief Behavior of the asynchronous backend when its queue is full
+/// @see cxxlog::async_options
+enum class overflow_policy {
+  /// @brief The logging thread waits until the queue has free space
+  block,
+  /// @brief The record being logged is discarded
+  drop_newest,
+  /// @brief The oldest queued record is discarded to make room
+  drop_oldest,
+};
+
+/// @brief Options of the asynchronous backend
+/// @see cxxlog::start_async
+struct async_options {
+  /// @brief Maximum number of queued records (rounded up to a power of two)
+  std::size_t capacity = 8192;
+  /// @brief Behavior when the queue is full
+  overflow_policy overflow = overflow_policy::block;
+  /// @brief Bytes reserved for the text of each queued record
+  ///
+  /// The slots of the queue are allocated once by cxxlog::start_async().
+  /// Longer records grow their slot, which is then reused as is.
+  std::size_t block_size = 256;
+};
+
+/// @brief Options of the per-thread backend
+/// @see cxxlog::start_thread_buffers
+struct thread_buffer_options {
+  /// @brief Number of records buffered per thread (rounded up to a power of
+  /// two)
+  std::size_t capacity = 1024;
+  /// @brief Behavior when the buffer of a thread is full
+  ///
+  /// overflow_policy::drop_oldest behaves like drop_newest because only the
+  /// collector thread removes records from a buffer.
+  overflow_policy overflow = overflow_policy::block;
+  /// @brief Interval at which the collector thread polls idle buffers
+  std::chrono::microseconds collect_interval = std::chrono::microseconds(1000);
+  /// @brief Bytes reserved for the text of each buffered record
+  std::size_t block_size = 256;
+};
+
+/// @brief When records written to output streams are flushed
+///
+/// Records end with `'\n'` rather than std::endl, so a stream is flushed
+/// only when one of these conditions holds after a record, by
+/// cxxlog::start_flusher(), or by the buffering of the stream itself.
+/// @see cxxlog::set_flush_policy
+struct flush_policy {
+  /// @brief Records at or above this severity flush their stream
+  severity_t severity = error;
+  /// @brief Bytes written to a stream since its last flush after which the
+  /// next record flushes it (0: no limit)
+  std::size_t watermark = 0;
+  /// @brief Time since the last flush of a stream after which the next
+  /// record flushes it (0: no limit)
+  std::chrono::milliseconds interval = std::chrono::milliseconds(0);
+};
+
+/// @brief Log-scale histogram of durations in nanoseconds
+struct latency_histogram {
+  static constexpr std::size_t bucket_count = 32;
+
+  /// @brief Bucket `i` counts durations in [2^i, 2^(i+1)) ns
+  ///
+  /// Bucket 0 also counts 0 and the last bucket everything above.
+  std::uint64_t buckets[bucket_count];
+
+  std::uint64_t count() const {
+    std::uint64_t total = 0;
+    for (const auto n : buckets) {
+      total += n;
+    }
+    return total;
+  }
+
+  /// @brief Upper bound of the bucket holding the given percentile
+  /// @param[in] percent - from 0 to 100
+  std::uint64_t percentile(double percent) const {
+    const auto target = static_cast<double>(count()) * percent / 100;
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      total += buckets[i];
+      if (buckets[i] != 0 && static_cast<double>(total) >= target) {
+        return (std::uint64_t(1) << (i + 1)) - 1;
+      }
+    }
+    return 0;
+  }
+};
+
+/// @brief Snapshot of the counters of the logger
+/// @see cxxlog::stats
+struct stats_snapshot {
+  /// @brief Records written, indexed by severity
+  std::uint64_t records[verbose + 1];
+  /// @brief Bytes of the records handed to destinations
+  std::uint64_t bytes;
+  /// @brief Writes to a stream which found its mutex locked
+  std::uint64_t lock_contentions;
+  /// @brief Time spent waiting for stream mutexes in nanoseconds
+  std::uint64_t lock_wait_ns;
+  /// @brief Records waiting in the background backend
+  std::size_t queued;
+  /// @brief Records discarded by the overflow policy
+  std::size_t dropped;
+  /// @brief Preallocated record slots of the background backend
+  std::size_t pool_blocks;
+  /// @brief Bytes reserved for the text of each slot
+  std::size_t pool_block_size;
+  /// @brief Records which did not fit in their slot and allocated
+  std::uint64_t pool_oversized;
+  /// @brief Time from the first inserted value to the end of the statement
+  ///
+  /// Measured only while cxxlog::enable_latency_stats() is on.
+  latency_histogram build;
+  /// @brief Time spent writing a record to all its destinations
+  ///
+  /// Measured only while cxxlog::enable_latency_stats() is on.
+  latency_histogram write;
+};
+
+namespace detail {
+
+/// @brief Counter written by a single thread and read by stats()
+struct shard_counter {
+  std::atomic<std::uint64_t> value;
+
+  void add(std::uint64_t n) {
+    value.store(value.load(std::memory_order_relaxed) + n,
+        std::memory_order_relaxed);
+  }
+
+  std::uint64_t get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+};
+
+/// @brief Counters of one thread
+struct stats_shard {
+  shard_counter records[verbose + 1];
+  shard_counter bytes;
+  shard_counter lock_contentions;
+  shard_counter lock_wait_ns;
+  shard_counter oversized;
+  shard_counter build[latency_histogram::bucket_count];
+  shard_counter write[latency_histogram::bucket_count];
+
+  void add_to(stats_snapshot *out) const {
+    for (int i = 0; i <= verbose; ++i) {
+      out->records[i] += records[i].get();
+    }
+    out->bytes += bytes.get();
+    out->lock_contentions += lock_contentions.get();
+    out->lock_wait_ns += lock_wait_ns.get();
+    out->pool_oversized += oversized.get();
+    for (std::size_t i = 0; i < latency_histogram::bucket_count; ++i) {
+      out->build.buckets[i] += build[i].get();
+      out->write.buckets[i] += write[i].get();
+    }
+  }
+
+  void add(const stats_shard &other) {
+    for (int i = 0; i <= verbose; ++i) {
+      records[i].add(other.records[i].get());
+    }
+    bytes.add(other.bytes.get());
+    lock_contentions.add(other.lock_contentions.get());
+    lock_wait_ns.add(other.lock_wait_ns.get());
+    oversized.add(other.oversized.get());
+    for (std::size_t i = 0; i < latency_histogram::bucket_count; ++i) {
+      build[i].add(other.build[i].get());
+      write[i].add(other.write[i].get());
+    }
+  }
+};
+
+/// @brief Shards of all threads, aggregated on read
+///
+/// Each thread only writes its own shard, so counting needs neither atomic
+/// read-modify-write nor shared cache lines. The shard of an exiting
+/// thread is folded into the retired totals.
+class stats_registry {
+ public:
+  /// @brief The registry is never destroyed, since background threads
+  /// may exit after the static objects
+  static stats_registry& instance() {
+    static stats_registry *registry = new stats_registry();
+    return *registry;
+  }
+
+  stats_registry(const stats_registry&) = delete;
+  stats_registry& operator=(const stats_registry&) = delete;
+
+  /// @brief Shard of the calling thread
+  static stats_shard& local() {
+    // a trivial thread_local is read without an initialization check
+    auto &shard = local_shard();
+    if (shard == nullptr) {
+      static thread_local shard_owner owner;
+      shard = owner.shard.get();
+    }
+    return *shard;
+  }
+
+  void collect(stats_snapshot *out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.add_to(out);
+    for (const auto shard : shards_) {
+      shard->add_to(out);
+    }
+  }
+
+ private:
+  struct shard_owner {
+    shard_owner() : shard(new stats_shard()) {
+      auto &registry = instance();
+      std::lock_guard<std::mutex> lock(registry.mutex_);
+      registry.shards_.push_back(shard.get());
+    }
+
+    ~shard_owner() {
+      auto &registry = instance();
+      std::lock_guard<std::mutex> lock(registry.mutex_);
+      registry.retired_.add(*shard);
+      registry.shards_.erase(std::find(
+          registry.shards_.begin(), registry.shards_.end(), shard.get()));
+      // records of later thread_local destructors are not counted
+      static stats_shard discarded;
+      local_shard() = &discarded;
+    }
+
+    std::unique_ptr<stats_shard> shard;
+  };
+
+  static stats_shard*& local_shard() {
+    static thread_local stats_shard *shard = nullptr;
+    return shard;
+  }
+
+  stats_registry() : retired_() {
+  }
+
+  std::mutex mutex_;
+  std::vector<stats_shard*> shards_;
+  stats_shard retired_;
+};
+
+/// @brief Switch of the latency histograms
+template<typename T = void>
+struct latency_stats {
+  static std::atomic<bool> enabled;
+};
+
+template<typename T>
+std::atomic<bool> latency_stats<T>::enabled(false);
+
+/// @brief Monotonic time in nanoseconds if latency stats are enabled, or 0
+inline std::uint64_t stats_clock() {
+#if CXXLOG_STATS
+  if (latency_stats<>::enabled.load(std::memory_order_relaxed)) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+#endif  // CXXLOG_STATS
+  return 0;
+}
+
+inline std::size_t latency_bucket(std::uint64_t ns) {
+  std::size_t bucket = 0;
+  while (ns > 1 && bucket + 1 < latency_histogram::bucket_count) {
+    ns >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+/// @brief Hooks of the instrumentation, empty without CXXLOG_STATS
+struct sink_stats {
+  static void record(severity_t severity, std::uint64_t begin) {
+#if CXXLOG_STATS
+    auto &shard = stats_registry::local();
+    shard.records[severity].add(1);
+    if (begin != 0) {
+      const auto end = stats_clock();
+      if (end != 0) {
+        shard.build[latency_bucket(end - begin)].add(1);
+      }
+    }
+#else
+    static_cast<void>(severity);
+    static_cast<void>(begin);
+#endif  // CXXLOG_STATS
+  }
+
+  static void written(std::size_t size, sink *s) {
+#if CXXLOG_STATS
+    stats_registry::local().bytes.add(size);
+    if (s != nullptr) {
+      s->bytes_written_.fetch_add(size, std::memory_order_relaxed);
+    }
+#else
+    static_cast<void>(size);
+    static_cast<void>(s);
+#endif  // CXXLOG_STATS
+  }
+
+  static void oversized() {
+#if CXXLOG_STATS
+    stats_registry::local().oversized.add(1);
+#endif  // CXXLOG_STATS
+  }
+
+  static void write_time(std::uint64_t begin) {
+#if CXXLOG_STATS
+    const auto end = stats_clock();
+    if (begin != 0 && end != 0) {
+      stats_registry::local().write[latency_bucket(end - begin)].add(1);
+    }
+#else
+    static_cast<void>(begin);
+#endif  // CXXLOG_STATS
+  }
+
+  /// @brief Locks the mutex of a stream, counting the time of contention
+  static std::unique_lock<std::mutex> lock(std::mutex &mutex) {
+#if CXXLOG_STATS
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      const auto begin = std::chrono::steady_clock::now();
+      lock.lock();
+      auto &shard = stats_registry::local();
+      shard.lock_contentions.add(1);
+      shard.lock_wait_ns.add(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - begin).count()));
+    }
+    return lock;
+#else
+    return std::unique_lock<std::mutex>(mutex);
+#endif  // CXXLOG_STATS
+  }
+};
+
+/// @brief Lock and flush state of the streams hashed onto one slot
+struct alignas(64) stream_slot {
+  std::mutex mutex;
+  /// @brief Bytes written since the last flush
+  std::size_t unflushed = 0;
+  /// @brief Time of the last flush, kept if flush_policy::interval is set
+  std::int64_t last_flush = 0;
+  /// @brief Stream waiting for the periodic flusher
+  std::ostream *dirty = nullptr;
+};
+
+/// @brief Flush policy of the streams and their slots, constant-initialized
+template<typename T = void>
+struct stream_flush {
+  static constexpr std::size_t slot_count = 64;
+
+  static std::atomic<int> severity;
+  static std::atomic<std::size_t> watermark;
+  /// @brief flush_policy::interval in nanoseconds
+  static std::atomic<std::int64_t> interval;
+  /// @brief Whether written streams are recorded for the periodic flusher
+  static std::atomic<bool> tracking;
+  static stream_slot slots[slot_count];
+};
+
+template<typename T>
+constexpr std::size_t stream_flush<T>::slot_count;
+
+template<typename T>
+std::atomic<int> stream_flush<T>::severity(error);
+
+template<typename T>
+std::atomic<std::size_t> stream_flush<T>::watermark(0);
+
+template<typename T>
+std::atomic<std::int64_t> stream_flush<T>::interval(0);
+
+template<typename T>
+std::atomic<bool> stream_flush<T>::tracking(false);
+
+template<typename T>
+stream_slot stream_flush<T>::slots[slot_count];
+
+/// @brief Slot guarding one output stream
+///
+/// Streams are hashed by address onto a fixed table of mutexes, each on its
+/// own cache line, so that unrelated streams are written concurrently while
+/// a record is never interleaved within one stream.
+inline stream_slot& get_stream_slot(const std::ostream *out) {
+  const auto address = reinterpret_cast<std::uintptr_t>(out);
+  const auto index =
+      ((address >> 4) ^ (address >> 10)) % stream_flush<>::slot_count;
+  return stream_flush<>::slots[index];
+}
+
+inline std::mutex& get_mutex(const std::ostream *out) {
+  return get_stream_slot(out).mutex;
+}
+
+inline std::int64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// @brief Flushes a stream and the stream waiting on its slot
+///
+/// The mutex of the slot must be held.
+inline void flush_stream_locked(stream_slot &slot, std::ostream *out) {
+  out->flush();
+  if (slot.dirty != nullptr && slot.dirty != out) {
+    slot.dirty->flush();
+  }
+  slot.dirty = nullptr;
+  slot.unflushed = 0;
+  if (stream_flush<>::interval.load(std::memory_order_relaxed) != 0) {
+    slot.last_flush = steady_ns();
+  }
+}
+
+/// @brief Applies the flush policy after a record has been written
+///
+/// The mutex of the slot must be held.
+inline void stream_written(
+    stream_slot &slot, std::ostream *out, const record &r) {
+  using policy = stream_flush<>;
+  slot.unflushed += r.size;
+  const auto watermark = policy::watermark.load(std::memory_order_relaxed);
+  const auto interval = policy::interval.load(std::memory_order_relaxed);
+  if ((r.severity != none &&
+       r.severity <= policy::severity.load(std::memory_order_relaxed)) ||
+      (watermark != 0 && slot.unflushed >= watermark) ||
+      (interval != 0 && steady_ns() - slot.last_flush >= interval)) {
+    flush_stream_locked(slot, out);
+  } else if (policy::tracking.load(std::memory_order_relaxed) &&
+             slot.dirty != out) {
+    if (slot.dirty != nullptr) {
+      // another stream hashed onto the slot is flushed to keep one pointer
+      slot.dirty->flush();
+    }
+    slot.dirty = out;
+  }
+}
+
+/// @brief Flushes the streams written since the last flush of their slot
+inline void flush_dirty_streams() {
+  for (auto &slot : stream_flush<>::slots) {
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    if (slot.dirty != nullptr) {
+      flush_stream_locked(slot, slot.dirty);
+    }
+  }
+}
+
+template<typename T>
+T* to_ptr(T &obj) {
+  return &obj;
+}
+
+template<typename T>
+T* to_ptr(T *obj) {
+  return obj;
+}
+
+inline std::nullptr_t to_ptr(std::nullptr_t) {
+  return nullptr;
+}
+
+/// @brief Output stream or sink receiving records
+struct destination {
+  std::ostream *stream;
+  cxxlog::sink *sink;
+};
+
+inline destination make_destination(std::ostream *out) {
+  return { out, nullptr };
+}
+
+inline destination make_destination(cxxlog::sink *out) {
+  return { nullptr, out };
+}
+
+inline destination make_destination(std::nullptr_t) {
+  return { nullptr, nullptr };
+}
+
+/// @brief List of destinations stored inline up to a small count
+///
+/// Loggers rarely write to more than a few destinations, so the first
+/// `inline_capacity` are kept in the object and only longer lists allocate.
+class destination_list {
+ public:
+  static constexpr std::size_t inline_capacity = 4;
+
+  destination_list() : size_(0) {
+  }
+
+  explicit destination_list(const destination &d) : size_(1) {
+    inline_[0] = d;
+  }
+
+  destination_list(const destination_list&) = default;
+  destination_list& operator=(const destination_list&) = default;
+
+  destination_list(destination_list &&other) noexcept
+      : size_(other.size_), heap_(std::move(other.heap_)) {
+    std::copy(other.inline_, other.inline_ + inline_size(), inline_);
+    other.clear();
+  }
+
+  destination_list& operator=(destination_list &&other) noexcept {
+    size_ = other.size_;
+    heap_ = std::move(other.heap_);
+    std::copy(other.inline_, other.inline_ + inline_size(), inline_);
+    other.clear();
+    return *this;
+  }
+
+  /// @brief Allocates once if more than `inline_capacity` will be added
+  void reserve(std::size_t n) {
+    if (n > inline_capacity) {
+      spill(n);
+    }
+  }
+
+  void push_back(const destination &d) {
+    if (on_heap()) {
+      heap_.push_back(d);
+    } else if (size_ < inline_capacity) {
+      inline_[size_] = d;
+    } else {
+      spill(inline_capacity * 2);
+      heap_.push_back(d);
+    }
+    ++size_;
+  }
+
+  void clear() {
+    size_ = 0;
+    heap_.clear();
+  }
+
+  /// @brief Removes the sinks whose level filters out the severity
+  void remove_disabled(severity_t severity) {
+    const auto first = on_heap() ? heap_.data() : inline_;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (first[i].sink == nullptr || first[i].sink->enabled(severity)) {
+        first[kept++] = first[i];
+      }
+    }
+    if (on_heap()) {
+      heap_.resize(kept);
+    }
+    size_ = kept;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  const destination* begin() const {
+    return on_heap() ? heap_.data() : inline_;
+  }
+
+  const destination* end() const {
+    return begin() + size_;
+  }
+
+ private:
+  /// @brief Whether the destinations have moved to the heap
+  ///
+  /// A cleared list keeps using its allocation.
+  bool on_heap() const {
+    return heap_.capacity() != 0;
+  }
+
+  std::size_t inline_size() const {
+    return on_heap() ? 0 : size_;
+  }
+
+  void spill(std::size_t capacity) {
+    if (!on_heap()) {
+      heap_.reserve(capacity);
+      heap_.assign(inline_, inline_ + size_);
+    }
+  }
+
+  std::size_t size_;
+  destination inline_[inline_capacity];
+  std::vector<destination> heap_;
+};
+
+inline void add_destinations(destination_list*) {
+}
+
+template<typename Output, typename... Args>
+void add_destinations(
+    destination_list *destinations, Output &&out, Args &&...args) {
+  auto out_ptr = to_ptr(std::forward<Output>(out));
+  if (out_ptr != nullptr) {
+    destinations->push_back(make_destination(out_ptr));
+  }
+  add_destinations(destinations, std::forward<Args>(args)...);
+}
+
+/// @brief Sequence of columns stored by value
+///
+/// Each column is invoked in order and followed by a space. The stream flags
+/// are restored after each column so that manipulators do not leak.
+template<typename... Columns>
+struct column_pack;
+
+template<>
+struct column_pack<> {
+  void write(const col::arguments&) {
+  }
+};
+
+template<typename Head, typename... Tail>
+struct column_pack<Head, Tail...> {
+  column_pack() = default;
+
+  template<typename H, typename... T>
+  explicit column_pack(H &&h, T &&...t)
+      : head(std::forward<H>(h)), tail(std::forward<T>(t)...) {
+  }
+
+  void write(const col::arguments &args) {
+    const auto flags = args.out.flags();
+    head(args);
+    args.out.flags(flags);
+    args.out.put(' ');
+    tail.write(args);
+  }
+
+  Head head;
+  column_pack<Tail...> tail;
+};
+
+/// @brief Type-erased column pack held without heap allocation
+///
+/// Stateless packs are written through a function pointer only; packs built
+/// from column objects are stored inline, or on the heap if they are larger
+/// than the inline storage.
+class column_set {
+  using storage_type = std::aligned_storage<
+      8 * sizeof(void*), alignof(std::max_align_t)>::type;
+
+ public:
+  column_set() : object_(nullptr), write_(nullptr), destroy_(nullptr) {
+  }
+
+  column_set(const column_set&) = delete;
+  column_set& operator=(const column_set&) = delete;
+
+  ~column_set() {
+    reset();
+  }
+
+  using writer = void (*)(void*, const col::arguments&);
+
+  /// @brief Writer of default constructed columns
+  template<typename Pack>
+  static writer stateless() {
+    return &write_stateless<Pack>;
+  }
+
+  /// @brief Uses default constructed columns for each record
+  template<typename Pack>
+  void assign() {
+    assign(stateless<Pack>());
+  }
+
+  /// @brief Uses a writer of default constructed columns
+  /// @see stateless
+  void assign(writer write) {
+    reset();
+    write_ = write;
+  }
+
+  /// @brief Stores the given column objects
+  template<typename Pack, typename... Columns>
+  void emplace(Columns &&...columns) {
+    reset();
+    construct<Pack>(fits_inline<Pack>(), std::forward<Columns>(columns)...);
+    write_ = &write_object<Pack>;
+  }
+
+  void reset() {
+    if (destroy_ != nullptr) {
+      destroy_(object_);
+    }
+    object_ = nullptr;
+    write_ = nullptr;
+    destroy_ = nullptr;
+  }
+
+  bool empty() const {
+    return write_ == nullptr;
+  }
+
+  void write(const col::arguments &args) {
+    write_(object_, args);
+  }
+
+ private:
+  template<typename Pack>
+  using fits_inline = std::integral_constant<bool,
+      (sizeof(Pack) <= sizeof(storage_type)) &&
+      (alignof(Pack) <= alignof(std::max_align_t))>;
+
+  template<typename Pack, typename... Columns>
+  void construct(std::true_type, Columns &&...columns) {
+    object_ = new(&storage_) Pack(std::forward<Columns>(columns)...);
+    destroy_ = &destroy_inline<Pack>;
+  }
+
+  template<typename Pack, typename... Columns>
+  void construct(std::false_type, Columns &&...columns) {
+    object_ = new Pack(std::forward<Columns>(columns)...);
+    destroy_ = &destroy_heap<Pack>;
+  }
+
+  template<typename Pack>
+  static void write_stateless(void*, const col::arguments &args) {
+    Pack pack;
+    pack.write(args);
+  }
+
+  template<typename Pack>
+  static void write_object(void *object, const col::arguments &args) {
+    static_cast<Pack*>(object)->write(args);
+  }
+
+  template<typename Pack>
+  static void destroy_inline(void *object) {
+    static_cast<Pack*>(object)->~Pack();
+  }
+
+  template<typename Pack>
+  static void destroy_heap(void *object) {
+    delete static_cast<Pack*>(object);
+  }
+
+  storage_type storage_;
+  void *object_;
+  writer write_;
+  void (*destroy_)(void*);
+};
+
+using default_columns = column_pack<CXXLOG_DEFAULT_COLUMNS>;
+
+inline void write_destination(const record &r, const destination &d) {
+  if (d.sink != nullptr) {
+    d.sink->write(r);
+  } else if (d.stream != nullptr) {
+    auto &slot = get_stream_slot(d.stream);
+    const auto lock = sink_stats::lock(slot.mutex);
+    d.stream->write(r.data, static_cast<std::streamsize>(r.size));
+    stream_written(slot, d.stream, r);
+  }
+}
+
+/// @brief Whether a destination reads the text rather than the fields
+inline bool needs_text(const destination_list &destinations) {
+  for (const auto &d : destinations) {
+    if (d.stream != nullptr || !d.sink->structured()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void write_destinations(
+    const record &r, const destination_list &destinations) {
+  const auto begin = stats_clock();
+  shared_record shared;
+  for (const auto &d : destinations) {
+    if (d.sink != nullptr && d.sink->shared()) {
+      if (!shared) {
+        shared = shared_record(r);
+      }
+      d.sink->write_shared(shared);
+    } else {
+      write_destination(r, d);
+    }
+    sink_stats::written(r.size, d.sink);
+  }
+  sink_stats::write_time(begin);
+}
+
+inline void flush_destination(const destination &d) {
+  if (d.sink != nullptr) {
+    d.sink->flush();
+  } else if (d.stream != nullptr) {
+    auto &slot = get_stream_slot(d.stream);
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    flush_stream_locked(slot, d.stream);
+  }
+}
+
+/// @brief Sinks holding records in memory
+///
+/// Registered sinks are flushed after every fatal record, and the crash
+/// handler writes what they hold with an async-signal-safe function. The
+/// slots are constant-initialized and read without locking, so a signal
+/// handler can walk them; the mutex only keeps a sink alive while it is
+/// flushed by flush_all().
+template<typename T = void>
+struct buffered_sinks {
+  /// @brief Async-signal-safe output of the crash handler
+  using emergency_output = void (*)(const char *data, std::size_t size);
+
+  /// @brief Writes the buffer of a sink using async-signal-safe calls only
+  ///
+  /// Records which have not reached a file of their own yet are passed to
+  /// the output of the crash handler.
+  using emergency_writer = void (*)(sink*, emergency_output output);
+
+  struct slot {
+    std::atomic<sink*> owner;
+    std::atomic<emergency_writer> write;
+  };
+
+  static constexpr std::size_t capacity = 64;
+  static slot slots[capacity];
+  static std::mutex mutex;
+
+  /// @return false if all slots are in use
+  static bool add(sink *owner, emergency_writer write) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &s : slots) {
+      if (s.owner.load(std::memory_order_relaxed) == nullptr) {
+        s.write.store(write, std::memory_order_relaxed);
+        s.owner.store(owner, std::memory_order_release);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void remove(sink *owner) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &s : slots) {
+      if (s.owner.load(std::memory_order_relaxed) == owner) {
+        s.owner.store(nullptr, std::memory_order_release);
+      }
+    }
+  }
+
+  static void flush_all() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &s : slots) {
+      const auto owner = s.owner.load(std::memory_order_relaxed);
+      if (owner != nullptr) {
+        owner->flush();
+      }
+    }
+  }
+
+  /// @brief Async-signal-safe
+  static void write_all(emergency_output output) {
+    for (auto &s : slots) {
+      const auto owner = s.owner.load(std::memory_order_acquire);
+      if (owner != nullptr) {
+        s.write.load(std::memory_order_relaxed)(owner, output);
+      }
+    }
+  }
+};
+
+template<typename T>
+constexpr std::size_t buffered_sinks<T>::capacity;
+
+template<typename T>
+typename buffered_sinks<T>::slot buffered_sinks<T>::slots[capacity];
+
+template<typename T>
+std::mutex buffered_sinks<T>::mutex;
+
+/// @brief Stream buffer formatting records into inline storage
+///
+/// A record longer than @ref CXXLOG_INLINE_BUFFER_SIZE is moved to a heap
+/// block, which is kept for the next oversized record.
+class record_buffer : public std::streambuf {
+ public:
+  record_buffer() : heap_size_(0) {
+    clear();
+  }
+
+  record_buffer(const record_buffer&) = delete;
+  record_buffer& operator=(const record_buffer&) = delete;
+
+  const char* data() const {
+    return pbase();
+  }
+
+  std::size_t size() const {
+    return static_cast<std::size_t>(pptr() - pbase());
+  }
+
+  /// @brief Empties the buffer and returns to the inline storage
+  ///
+  /// The heap block of an oversized record is kept for the next one unless
+  /// it is larger than @ref CXXLOG_RETAINED_BUFFER_SIZE.
+  void clear() {
+    if (heap_size_ > CXXLOG_RETAINED_BUFFER_SIZE) {
+      heap_.reset();
+      heap_size_ = 0;
+    }
+    setp(inline_, inline_ + sizeof(inline_));
+  }
+
+  /// @brief Space for at least `n` characters at the end of the buffer
+  /// @see commit
+  char* prepare(std::size_t n) {
+    if (n > static_cast<std::size_t>(epptr() - pptr())) {
+      reserve(n);
+    }
+    return pptr();
+  }
+
+  /// @brief Appends the `n` characters written into prepare()'d space
+  void commit(std::size_t n) {
+    pbump(static_cast<int>(n));
+  }
+
+  void append(const char *s, std::size_t n) {
+    std::memcpy(prepare(n), s, n);
+    commit(n);
+  }
+
+ protected:
+  int_type overflow(int_type ch) override {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+      return traits_type::not_eof(ch);
+    }
+    reserve(1);
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    const auto count = static_cast<std::size_t>(n);
+    if (count > static_cast<std::size_t>(epptr() - pptr())) {
+      reserve(count);
+    }
+    std::memcpy(pptr(), s, count);
+    pbump(static_cast<int>(n));
+    return n;
+  }
+
+ private:
+  /// @brief Moves the text to the heap block, growing it if needed
+  void reserve(std::size_t n) {
+    const auto used = size();
+    if (pbase() == heap_.get() || heap_size_ < used + n) {
+      auto capacity = std::max<std::size_t>(
+          2 * static_cast<std::size_t>(epptr() - pbase()), heap_size_);
+      while (capacity < used + n) {
+        capacity *= 2;
+      }
+      std::unique_ptr<char[]> block(new char[capacity]);
+      std::memcpy(block.get(), pbase(), used);
+      heap_ = std::move(block);
+      heap_size_ = capacity;
+    } else {
+      std::memcpy(heap_.get(), pbase(), used);
+    }
+    setp(heap_.get(), heap_.get() + heap_size_);
+    pbump(static_cast<int>(used));
+  }
+
+  char inline_[CXXLOG_INLINE_BUFFER_SIZE];
+  std::unique_ptr<char[]> heap_;
+  std::size_t heap_size_;
+};
+
+/// @brief Output stream bound to a reusable record buffer
+struct record_stream {
+  record_stream()
+      : buffer(), out(&buffer), flags(out.flags()),
+        classic(out.getloc() == std::locale::classic()) {
+  }
+
+  /// @brief Restores the state left by the previous record
+  void reset() {
+    buffer.clear();
+    fields.clear();
+    out.clear();
+    out.flags(flags);
+    out.fill(' ');
+    out.precision(6);
+    out.width(0);
+  }
+
+  record_buffer buffer;
+  /// @brief Encoded structured fields
+  std::string fields;
+  std::ostream out;
+  const std::ios_base::fmtflags flags;
+  /// @brief Whether numbers are formatted without locale-specific grouping
+  const bool classic;
+};
+
+/// @brief Thread-local free list of record streams
+///
+/// Streams are recycled so that formatting a record does not allocate once
+/// the buffers have grown to the working size. Nested loggers (a logger used
+/// inside an inserted value's `operator<<`) simply take another stream.
+class record_stream_pool {
+ public:
+  static record_stream* acquire() {
+    auto pool = local();
+    if (pool != nullptr && !pool->free_.empty()) {
+      auto stream = pool->free_.back().release();
+      pool->free_.pop_back();
+      return stream;
+    }
+    return new record_stream();
+  }
+
+  static void release(record_stream *stream) {
+    auto pool = local();
+    if (pool != nullptr) {
+      stream->reset();
+      pool->free_.emplace_back(stream);
+    } else {
+      delete stream;
+    }
+  }
+
+ private:
+  enum state_t { uninitialized, alive, destroyed };
+
+  record_stream_pool() {
+    state() = alive;
+  }
+
+  ~record_stream_pool() {
+    state() = destroyed;
+  }
+
+  static state_t& state() {
+    static thread_local state_t state = uninitialized;
+    return state;
+  }
+
+  /// @return nullptr while the thread is exiting
+  static record_stream_pool* local() {
+    if (state() == destroyed) {
+      return nullptr;
+    }
+    static thread_local record_stream_pool pool;
+    return &pool;
+  }
+
+  std::vector<std::unique_ptr<record_stream>> free_;
+};
+
+/// @brief How a value is inserted into a record stream
+enum class insert_kind {
+  stream, boolean, character, integer, floating, c_string, string, pointer
+};
+
+template<typename T>
+struct is_c_string : std::false_type {
+};
+
+template<typename T>
+struct is_c_string<T*> : std::integral_constant<bool,
+    std::is_same<typename std::remove_const<T>::type, char>::value ||
+    std::is_same<typename std::remove_const<T>::type, signed char>::value ||
+    std::is_same<typename std::remove_const<T>::type, unsigned char>::value> {
+};
+
+template<typename T>
+struct insert_traits {
+  using type = typename std::decay<T>::type;
+  static constexpr insert_kind value =
+      std::is_same<type, bool>::value ? insert_kind::boolean :
+      (std::is_same<type, char>::value ||
+       std::is_same<type, signed char>::value ||
+       std::is_same<type, unsigned char>::value) ? insert_kind::character :
+      std::is_integral<type>::value ? insert_kind::integer :
+      std::is_floating_point<type>::value ? insert_kind::floating :
+      is_c_string<type>::value ? insert_kind::c_string :
+      std::is_same<type, std::string>::value ? insert_kind::string :
+      (std::is_pointer<type>::value &&
+       std::is_convertible<type, const void*>::value) ? insert_kind::pointer :
+      insert_kind::stream;
+};
+
+template<insert_kind Kind>
+using insert_tag = std::integral_constant<insert_kind, Kind>;
+
+/// @brief Whether the stream is in the state the fast paths assume
+inline bool plain(const record_stream &s) {
+  return s.out.width() == 0 && s.out.rdstate() == std::ios_base::goodbit;
+}
+
+/// @brief Whether integers are formatted as `%d` would
+inline bool plain_integer(const record_stream &s) {
+  const auto flags = s.out.flags();
+  const auto base = flags & std::ios_base::basefield;
+  return plain(s) && s.classic && (flags & std::ios_base::showpos) == 0 &&
+      (base == std::ios_base::dec || base == 0);
+}
+
+template<typename T>
+void insert(record_stream &s, T &&value, insert_tag<insert_kind::stream>) {
+  s.out << std::forward<T>(value);
+}
+
+inline void insert(record_stream &s, bool value,
+    insert_tag<insert_kind::boolean>) {
+  if (plain(s) && (s.out.flags() & std::ios_base::boolalpha) == 0) {
+    s.buffer.append(value ? "1" : "0", 1);
+  } else {
+    s.out << value;
+  }
+}
+
+template<typename T>
+void insert(record_stream &s, T value, insert_tag<insert_kind::character>) {
+  if (plain(s)) {
+    const auto ch = static_cast<char>(value);
+    s.buffer.append(&ch, 1);
+  } else {
+    s.out << value;
+  }
+}
+
+template<typename T>
+bool is_negative(T value, std::true_type) {
+  return value < 0;
+}
+
+template<typename T>
+bool is_negative(T, std::false_type) {
+  return false;
+}
+
+template<typename T>
+void insert(record_stream &s, T value, insert_tag<insert_kind::integer>) {
+  if (!plain_integer(s)) {
+    s.out << value;
+    return;
+  }
+  auto out = s.buffer.prepare(24);
+  const auto begin = out;
+  std::uint64_t magnitude = static_cast<std::uint64_t>(value);
+  if (is_negative(value, std::is_signed<T>())) {
+    *out++ = '-';
+    magnitude = 0 - magnitude;
+  }
+  out = format_uint(out, magnitude, 0);
+  s.buffer.commit(static_cast<std::size_t>(out - begin));
+}
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+template<typename T>
+int format_float(char *out, std::size_t size, T value,
+    std::ios_base::fmtflags floatfield, bool upper, int precision) {
+  const auto format =
+      (floatfield == std::ios_base::fixed) ? std::chars_format::fixed :
+      (floatfield == std::ios_base::scientific) ?
+          std::chars_format::scientific : std::chars_format::general;
+  const auto result = std::to_chars(out, out + size, value, format, precision);
+  if (result.ec != std::errc()) {
+    return -1;
+  }
+  if (upper) {
+    for (auto p = out; p != result.ptr; ++p) {
+      if (*p >= 'a' && *p <= 'z') {
+        *p = static_cast<char>(*p - 'a' + 'A');
+      }
+    }
+  }
+  return static_cast<int>(result.ptr - out);
+}
+#else
+/// @brief Fallback of `std::to_chars` before C++17
+template<typename T>
+int format_float(char *out, std::size_t size, T value,
+    std::ios_base::fmtflags floatfield, bool upper, int precision) {
+  const char conversion =
+      (floatfield == std::ios_base::fixed) ? (upper ? 'F' : 'f') :
+      (floatfield == std::ios_base::scientific) ? (upper ? 'E' : 'e') :
+      (upper ? 'G' : 'g');
+  const bool extended = std::is_same<T, long double>::value;
+  char format[] = { '%', '.', '*', 'L', conversion, '\0' };
+  if (!extended) {
+    format[3] = conversion;
+    format[4] = '\0';
+  }
+  const int n = extended ?
+      std::snprintf(out, size, format, precision,
+          static_cast<long double>(value)) :
+      std::snprintf(out, size, format, precision, static_cast<double>(value));
+  return (n >= 0 && static_cast<std::size_t>(n) < size) ? n : -1;
+}
+#endif
+
+template<typename T>
+void insert(record_stream &s, T value, insert_tag<insert_kind::floating>) {
+  constexpr std::size_t size = 64;
+  const auto flags = s.out.flags();
+  const auto floatfield = flags & std::ios_base::floatfield;
+  if (plain(s) && s.classic &&
+      (flags & (std::ios_base::showpos | std::ios_base::showpoint)) == 0 &&
+      floatfield != (std::ios_base::fixed | std::ios_base::scientific)) {
+    const auto out = s.buffer.prepare(size);
+    const int n = format_float(out, size, value, floatfield,
+        (flags & std::ios_base::uppercase) != 0,
+        static_cast<int>(s.out.precision()));
+    if (n >= 0) {
+      s.buffer.commit(static_cast<std::size_t>(n));
+      return;
+    }
+  }
+  s.out << value;
+}
+
+template<typename T>
+void insert(record_stream &s, T value, insert_tag<insert_kind::c_string>) {
+  if (value != nullptr && plain(s)) {
+    const auto text = reinterpret_cast<const char*>(value);
+    s.buffer.append(text, std::strlen(text));
+  } else {
+    s.out << value;
+  }
+}
+
+inline void insert(record_stream &s, const std::string &value,
+    insert_tag<insert_kind::string>) {
+  if (plain(s)) {
+    s.buffer.append(value.data(), value.size());
+  } else {
+    s.out << value;
+  }
+}
+
+inline void insert(record_stream &s, const void *value,
+    insert_tag<insert_kind::pointer>) {
+  if (!plain(s)) {
+    s.out << value;
+    return;
+  }
+  auto address = reinterpret_cast<std::uintptr_t>(value);
+  if (address == 0) {
+    s.buffer.append("0", 1);
+    return;
+  }
+  char digits[2 + 2 * sizeof(address)];
+  auto begin = digits + sizeof(digits);
+  do {
+    *--begin = "0123456789abcdef"[address & 0xf];
+    address >>= 4;
+  } while (address != 0);
+  *--begin = 'x';
+  *--begin = '0';
+  s.buffer.append(
+      begin, static_cast<std::size_t>(digits + sizeof(digits) - begin));
+}
+
+/// @brief Inserts a value into a record stream
+///
+/// Booleans, characters, numbers, strings and pointers are written directly
+/// into the buffer while the stream has its default format state, bypassing
+/// the locale facets of `std::ostream`. Anything else, and any value inserted
+/// after a manipulator has changed the width, base or notation, goes through
+/// `operator<<` as usual with the same output.
+template<typename T>
+void insert(record_stream &s, T &&value) {
+  insert(s, std::forward<T>(value),
+      insert_tag<insert_traits<T>::value>());
+}
+
+/// @brief Writes the header of an encoded field
+inline void put_field(std::string *out, field_type type,
+    const char *key, std::size_t key_size) {
+  key_size = (std::min)(key_size, static_cast<std::size_t>(255));
+  out->push_back(static_cast<char>(type));
+  out->push_back(static_cast<char>(key_size));
+  out->append(key, key_size);
+}
+
+template<typename T>
+void put_field_value(std::string *out, const T &value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void put_field_string(std::string *out, const char *text,
+    std::size_t size) {
+  const auto length = static_cast<std::uint32_t>(size);
+  put_field_value(out, length);
+  out->append(text, length);
+}
+
+template<typename T>
+void encode_field(std::string *out, const char *key, std::size_t key_size,
+    const T &value, insert_tag<insert_kind::boolean>) {
+  put_field(out, field_type::boolean, key, key_size);
+  out->push_back(value ? 1 : 0);
+}
+
+template<typename T>
+void encode_field(std::string *out, const char *key, std::size_t key_size,
+    const T &value, insert_tag<insert_kind::integer>) {
+  if (std::is_signed<T>::value) {
+    put_field(out, field_type::integer, key, key_size);
+    put_field_value(out, static_cast<std::int64_t>(value));
+  } else {
+    put_field(out, field_type::unsigned_integer, key, key_size);
+    put_field_value(out, static_cast<std::uint64_t>(value));
+  }
+}
+
+template<typename T>
+void encode_field(std::string *out, const char *key, std::size_t key_size,
+    const T &value, insert_tag<insert_kind::floating>) {
+  put_field(out, field_type::floating, key, key_size);
+  put_field_value(out, static_cast<double>(value));
+}
+
+template<typename T>
+void encode_field(std::string *out, const char *key, std::size_t key_size,
+    const T &value, insert_tag<insert_kind::character>) {
+  const auto ch = static_cast<char>(value);
+  put_field(out, field_type::string, key, key_size);
+  put_field_string(out, &ch, 1);
+}
+
+template<typename T>
+void encode_field(std::string *out, const char *key, std::size_t key_size,
+    const T &value, insert_tag<insert_kind::c_string>) {
+  const auto pointer = static_cast<typename std::decay<const T>::type>(value);
+  const auto text = (pointer != nullptr) ?
+      reinterpret_cast<const char*>(pointer) : "";
+  put_field(out, field_type::string, key, key_size);
+  put_field_string(out, text, std::strlen(text));
+}
+
+inline void encode_field(std::string *out, const char *key,
+    std::size_t key_size, const std::string &value,
+    insert_tag<insert_kind::string>) {
+  put_field(out, field_type::string, key, key_size);
+  put_field_string(out, value.data(), value.size());
+}
+
+/// @brief Stores pointers and user types as their `operator<<` text
+template<typename T, insert_kind Kind>
+void encode_field(std::string *out, const char *key, std::size_t key_size,
+    const T &value, insert_tag<Kind>) {
+  const auto stream = record_stream_pool::acquire();
+  insert(*stream, value);
+  put_field(out, field_type::string, key, key_size);
+  put_field_string(out, stream->buffer.data(), stream->buffer.size());
+  record_stream_pool::release(stream);
+}
+
+/// @brief Shortest text of a double that reads back as the same value
+inline char* format_double(char *out, double value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  return std::to_chars(out, out + 32, value).ptr;
+#else
+  int n = std::snprintf(out, 32, "%.15g", value);
+  if (std::strtod(out, nullptr) != value) {
+    n = std::snprintf(out, 32, "%.17g", value);
+  }
+  return out + n;
+#endif
+}
+
+/// @brief Appends the value of a non-string field as text
+template<typename Out>
+void append_field_number(Out &out, const field &f) {
+  char text[32];
+  char *end = text;
+  switch (f.type) {
+    case field_type::boolean:
+      out.append(f.boolean ? "true" : "false", f.boolean ? 4 : 5);
+      return;
+    case field_type::integer:
+      if (f.integer < 0) {
+        *end++ = '-';
+      }
+      end = format_uint(end, (f.integer < 0) ?
+          0 - static_cast<std::uint64_t>(f.integer) :
+          static_cast<std::uint64_t>(f.integer), 0);
+      break;
+    case field_type::unsigned_integer:
+      end = format_uint(end, f.unsigned_integer, 0);
+      break;
+    case field_type::floating:
+      end = format_double(text, f.floating);
+      break;
+    case field_type::string:
+      break;
+  }
+  out.append(text, static_cast<std::size_t>(end - text));
+}
+
+/// @brief Appends a logfmt value, quoted and escaped if needed
+template<typename Out>
+void append_logfmt_string(Out &out, const char *text, std::size_t size) {
+  bool quote = (size == 0);
+  for (std::size_t i = 0; i < size && !quote; ++i) {
+    const auto ch = static_cast<unsigned char>(text[i]);
+    quote = (ch <= ' ' || ch == '=' || ch == '"' || ch == '\\');
+  }
+  if (!quote) {
+    out.append(text, size);
+    return;
+  }
+  out.append("\"", 1);
+  std::size_t begin = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto ch = static_cast<unsigned char>(text[i]);
+    const char *escaped =
+        (ch == '"') ? "\\\"" : (ch == '\\') ? "\\\\" :
+        (ch == '\n') ? "\\n" : (ch == '\r') ? "\\r" :
+        (ch == '\t') ? "\\t" : nullptr;
+    if (escaped == nullptr && ch >= ' ') {
+      continue;
+    }
+    out.append(text + begin, i - begin);
+    if (escaped != nullptr) {
+      out.append(escaped, 2);
+    } else {
+      static const char digits[] = "0123456789abcdef";
+      const char hex[] = { '\\', 'x', digits[ch >> 4], digits[ch & 0xf] };
+      out.append(hex, sizeof(hex));
+    }
+    begin = i + 1;
+  }
+  out.append(text + begin, size - begin);
+  out.append("\"", 1);
+}
+
+/// @brief Appends the fields of a record as ` key=value` pairs
+/// @param[in] separate - whether to put a space before the first pair
+/// @brief Appends a key, with the characters that would end it (space,
+/// `=`, `"`, `\` and control characters) replaced by `_`
+/// @param[in] max_size - longer keys are truncated
+template<typename Out>
+void append_key(Out &out, const char *key, std::size_t size,
+    std::size_t max_size = static_cast<std::size_t>(-1)) {
+  if (size == 0) {
+    out.append("_", 1);
+    return;
+  }
+  size = std::min(size, max_size);
+  std::size_t begin = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto ch = static_cast<unsigned char>(key[i]);
+    if (ch > ' ' && ch != '=' && ch != '"' && ch != '\\' && ch != 0x7f) {
+      continue;
+    }
+    out.append(key + begin, i - begin);
+    out.append("_", 1);
+    begin = i + 1;
+  }
+  out.append(key + begin, size - begin);
+}
+
+template<typename Out>
+void append_logfmt_fields(Out &out, const record &r, bool separate) {
+  for_each_field(r, [&out, &separate](const field &f) {
+    if (separate) {
+      out.append(" ", 1);
+    }
+    separate = true;
+    append_key(out, f.key, f.key_size);
+    out.append("=", 1);
+    if (f.type == field_type::string) {
+      append_logfmt_string(out, f.text, f.text_size);
+    } else {
+      append_field_number(out, f);
+    }
+  });
+}
+
+/// @brief Hands a record to the running backend or writes it
+CXXLOG_API void publish(const record &r, destination_list &&destinations);
+
+/// @brief Whether records are written by a background thread
+CXXLOG_API bool background_running();
+
+/// @brief Writes everything logged so far, including the buffers of sinks
+///
+/// Called after each fatal record, so that it reaches its destinations
+/// before the program goes down.
+CXXLOG_API void flush_pipeline(const destination_list &destinations);
+
+}  // namespace detail
+
+/// @brief Starts the asynchronous backend
+///
+/// After this call, finished records are queued and written by a dedicated
+/// writer thread instead of the logging thread. The backend is drained and
+/// stopped at exit, but output streams must outlive it; call
+/// cxxlog::stop_async() or cxxlog::flush() before destroying them.
+/// @code {.cxx}
+/// cxxlog::async_options options;
+/// options.overflow = cxxlog::overflow_policy::drop_oldest;
+/// cxxlog::start_async(options);
+/// @endcode
+/// @param[in] options - queue capacity and overflow policy
+CXXLOG_API void start_async(const async_options &options = async_options());
+
+/// @brief Drains the queue and stops the asynchronous backend
+///
+/// Records logged afterwards are written synchronously.
+CXXLOG_API void stop_async();
+
+/// @brief Starts the per-thread backend
+///
+/// After this call, each thread appends finished records to its own buffer
+/// and a collector thread writes them in timestamp order. Logging threads
+/// do not synchronize with each other, so throughput scales with the
+/// number of threads. Records of exiting threads are not lost. As with
+/// cxxlog::start_async(), output streams must outlive the backend.
+/// @code {.cxx}
+/// cxxlog::thread_buffer_options options;
+/// options.capacity = 4096;
+/// cxxlog::start_thread_buffers(options);
+/// @endcode
+/// @param[in] options - buffer capacity, overflow policy and poll interval
+CXXLOG_API void start_thread_buffers(
+    const thread_buffer_options &options = thread_buffer_options());
+
+/// @brief Drains the buffers and stops the per-thread backend
+CXXLOG_API void stop_thread_buffers();
+
+/// @brief Waits until all records queued so far have been written
+CXXLOG_API void flush();
+
+/// @brief Sets when records written to output streams are flushed
+///
+/// By default, records at or above cxxlog::error flush their stream and
+/// the others stay in the buffer of the stream, so that errors are durable
+/// at once while lower severities are written in batches. Sinks have their
+/// own options, such as cxxlog::file_options.
+/// @code {.cxx}
+/// cxxlog::flush_policy policy;
+/// policy.severity = cxxlog::warning;
+/// policy.watermark = 64 * 1024;
+/// policy.interval = std::chrono::milliseconds(500);
+/// cxxlog::set_flush_policy(policy);
+/// @endcode
+/// @param[in] policy - flush conditions
+inline void set_flush_policy(const flush_policy &policy) {
+  using state = detail::stream_flush<>;
+  state::severity.store(policy.severity, std::memory_order_relaxed);
+  state::watermark.store(policy.watermark, std::memory_order_relaxed);
+  state::interval.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          policy.interval).count(),
+      std::memory_order_relaxed);
+}
+
+/// @brief Gets the flush policy of output streams
+inline flush_policy get_flush_policy() {
+  using state = detail::stream_flush<>;
+  flush_policy policy;
+  policy.severity = static_cast<severity_t>(
+      state::severity.load(std::memory_order_relaxed));
+  policy.watermark = state::watermark.load(std::memory_order_relaxed);
+  policy.interval = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::nanoseconds(
+          state::interval.load(std::memory_order_relaxed)));
+  return policy;
+}
+
+/// @brief Starts a thread flushing streams and buffered sinks periodically
+///
+/// Records left in a buffer by the flush policy, or by the options of
+/// cxxlog::file_sink, are then written even if no other record follows.
+/// Output streams written while the flusher runs must outlive it; call
+/// cxxlog::stop_flusher() before destroying them.
+/// @param[in] period - interval between flushes
+CXXLOG_API void start_flusher(
+    std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+
+/// @brief Flushes the streams and stops the periodic flusher
+CXXLOG_API void stop_flusher();
+
+/// @brief Number of records discarded by the overflow policy
+CXXLOG_API std::size_t dropped_count();
+
+/// @brief Turns the latency histograms of cxxlog::stats() on or off
+///
+/// Off by default, since each record then reads a monotonic clock up to
+/// four times.
+/// @param[in] enabled - whether durations are measured
+inline void enable_latency_stats(bool enabled) {
+  detail::latency_stats<>::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/// @brief Reads the counters of the logger
+///
+/// The counters of each thread are kept apart and summed here, so logging
+/// threads do not contend on them. Bytes written to each sink are also
+/// available from cxxlog::sink::bytes_written().
+/// @code {.cxx}
+/// const auto s = cxxlog::stats();
+/// std::cerr << s.records[cxxlog::error] << " errors, "
+///     << s.write.percentile(99) << " ns p99 write" << std::endl;
+/// @endcode
+/// @see CXXLOG_STATS
+CXXLOG_API stats_snapshot stats();
+
+/// @brief Names the calling thread in col::thread
+///
+/// An empty name restores the thread id.
+/// @code {.cxx}
+/// cxxlog::set_thread_name("worker-1");
+/// CXXLOG_I.cols<cxxlog::col::thread>() << "named";  // worker-1 named
+/// @endcode
+/// @param[in] name - name of the thread
+inline void set_thread_name(const std::string &name) {
+  detail::this_thread_text().id = name;
+}
+
+/// @brief Sets the text of col::thread_prefix for the calling thread
+/// @param[in] prefix - static part of the lines of the thread
+inline void set_thread_prefix(const std::string &prefix) {
+  detail::this_thread_text().prefix = prefix;
+}
+
+/// @brief Renders columns once as the text of col::thread_prefix
+///
+/// The columns are written as they would be for a record, without the
+/// trailing space, so they should not depend on the record.
+/// @code {.cxx}
+/// cxxlog::set_thread_name("worker-1");
+/// cxxlog::set_thread_prefix<cxxlog::col::process_id, cxxlog::col::thread>();
+/// CXXLOG_I.cols<cxxlog::col::time, cxxlog::col::thread_prefix>() << "x";
+/// // 1647540198.640983 12345 worker-1 x
+/// @endcode
+template<typename... Columns>
+void set_thread_prefix() {
+  detail::record_buffer buffer;
+  std::ostream out(&buffer);
+  detail::column_pack<Columns...> columns;
+  columns.write({ out, none, {}, nullptr, nullptr, 0 });
+  const auto size = buffer.size();
+  set_thread_prefix(std::string(buffer.data(), size != 0 ? size - 1 : 0));
+}
+
+/// @brief Preconfigured destinations, columns and level shared by records
+///
+/// A channel is set up once and then referenced by CXXLOG_CH, so records do
+/// not repeat the outputs and columns at every call site. Like
+/// cxxlog::category, each channel has its own runtime level; set it to
+/// cxxlog::none to disable the channel.
+/// @code {.cxx}
+/// cxxlog::file_sink file("network.log");
+/// cxxlog::channel network(file, std::cerr);
+/// network.cols<cxxlog::col::iso8601, cxxlog::col::severity>();
+/// network.set_level(cxxlog::info);
+///
+/// CXXLOG_CH_I(network) << "connected";
+/// CXXLOG_CH_D(network) << "filtered by the channel";
+/// @endcode
+/// @see CXXLOG_CH
+class channel : public category {
+ public:
+  /// @brief Constructor
+  /// @param[in] outputs - output streams or cxxlog::sink
+  template<typename... Outputs>
+  explicit channel(Outputs &&...outputs)
+      : category(verbose),
+        columns_(detail::column_set::stateless<detail::default_columns>()) {
+    destinations_.reserve(sizeof...(Outputs));
+    detail::add_destinations(
+        &destinations_, std::forward<Outputs>(outputs)...);
+  }
+
+  /// @brief Specifies the columns at compile time
+  ///
+  /// Only stateless columns are supported, since records of a channel may
+  /// be written from many threads at once.
+  template<typename... Columns>
+  channel& cols() {
+    columns_.store(detail::column_set::stateless<
+        detail::column_pack<Columns...>>(), std::memory_order_relaxed);
+    return *this;
+  }
+
+  channel& cols() {
+    columns_.store(nullptr, std::memory_order_relaxed);
+    return *this;
+  }
+
+  /// @brief Destinations of the records
+  const detail::destination_list& destinations() const {
+    return destinations_;
+  }
+
+  /// @brief Writer of the columns, or nullptr if there are no columns
+  detail::column_set::writer columns() const {
+    return columns_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  detail::destination_list destinations_;
+  std::atomic<detail::column_set::writer> columns_;
+};
+
+/// @brief A simple logger that wraps the output stream
+class Logger {
+ public:
+  /// @brief Constructor
+  /// @param[in] severity - log severity
+  explicit Logger(severity_t severity)
+      : severity_(severity),
+        stream_(detail::record_stream_pool::acquire()),
+        time_(),
+        destinations_(detail::make_destination(detail::standard_output())),
+        columns_(),
+        suppressed_(0),
+        message_offset_(0),
+        location_(nullptr),
+        function_(nullptr),
+        build_begin_(0) {
+    columns_.assign<detail::default_columns>();
+  }
+
+  /// @brief Constructor
+  /// @param[in] severity - log severity
+  /// @param[in] ch - channel providing the destinations and columns
+  Logger(severity_t severity, const channel &ch)
+      : severity_(severity),
+        stream_(detail::record_stream_pool::acquire()),
+        time_(),
+        destinations_(ch.destinations()),
+        columns_(),
+        suppressed_(0),
+        message_offset_(0),
+        location_(nullptr),
+        function_(nullptr),
+        build_begin_(0) {
+    destinations_.remove_disabled(severity);
+    const auto columns = ch.columns();
+    if (columns != nullptr) {
+      columns_.assign(columns);
+    }
+  }
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  /// @brief Destructor
+  ///
+  /// If data is inserted, flush it. A fatal record is written through the
+  /// background backend and the buffers of the sinks before returning.
+  ~Logger();
+
+  /// @brief Specifies the output streams and sinks
+  ///
+  /// Examples:
+  /// @code {.cxx}
+  /// CXXLOG_E(std::cerr) << "standard error ref";
+  /// CXXLOG_E(&std::cerr) << "standard error ptr";
+  ///
+  /// std::ofstream fs("log.txt");
+  /// CXXLOG_E(&fs) << "file stream";
+  ///
+  /// CXXLOG_E(std::cerr, fs) << "multiple outputs";
+  ///
+  /// cxxlog::file_sink file("log.txt");
+  /// CXXLOG_E(file, std::cerr) << "sink and stream";
+  /// @endcode
+  /// Sinks whose level filters out the severity are left out; see
+  /// cxxlog::sink::set_level().
+  /// @param[in] output_streams - output streams or cxxlog::sink
+  template<typename... OutputStreams>
+  Logger& operator()(OutputStreams &&...output_streams) {
+    destinations_.clear();
+    destinations_.reserve(sizeof...(OutputStreams));
+    detail::add_destinations(
+        &destinations_, std::forward<OutputStreams>(output_streams)...);
+    destinations_.remove_disabled(severity_);
+    return *this;
+  }
+
+  Logger& operator()() {
+    return *this;
+  }
+
+  /// @brief Specifies the columns
+  ///
+  /// Examples:
+  /// @code {.cxx}
+  /// CXXLOG_E.cols() << "no columns";
+  /// CXXLOG_E.cols(cxxlog::col::time()) << "time column only";
+  /// CXXLOG_E.cols(cxxlog::col::severity(), cxxlog::col::time())
+  ///     << "multiple columns";
+  /// @endcode
+  /// @param[in] functions - column funcions
+  template<typename... ColumnFunctions>
+  Logger& cols(ColumnFunctions &&...functions) {
+    if (!started()) {
+      columns_.emplace<detail::column_pack<
+          typename std::decay<ColumnFunctions>::type...>>(
+              std::forward<ColumnFunctions>(functions)...);
+    }
+    return *this;
+  }
+
+  /// @brief Specifies the columns at compile time
+  ///
+  /// The columns are default constructed for each record, so stateless
+  /// columns are inlined and nothing is stored.
+  ///
+  /// Examples:
+  /// @code {.cxx}
+  /// CXXLOG_E.cols<cxxlog::col::severity, cxxlog::col::time>()
+  ///     << "compile-time columns";
+  /// @endcode
+  template<typename... Columns>
+  Logger& cols() {
+    if (!started()) {
+      columns_.assign<detail::column_pack<Columns...>>();
+    }
+    return *this;
+  }
+
+  Logger& cols() {
+    if (!started()) {
+      columns_.reset();
+    }
+    return *this;
+  }
+
+  /// @brief Specifies the call site for col::location and col::function
+  /// @param[in] location - call site
+  /// @param[in] function - name of the calling function
+  /// @see CXXLOG_LOCATION
+  Logger& at(const source_location &location,
+      const char *function = CXXLOG_CALLER_FUNCTION) {
+    location_ = &location;
+    function_ = function;
+    return *this;
+  }
+
+  /// @brief Appends the number of suppressed records to the record
+  /// @param[in] count - number of records suppressed by a rate limit
+  /// @see CXXLOG_LIMIT
+  Logger& suppressed(std::uint64_t count) {
+    suppressed_ = count;
+    return *this;
+  }
+
+  /// @brief Inserts data into the output stream
+  /// @param[in] value - value to insert
+  template<typename T>
+  Logger& operator<<(T &&value) {
+    if (!destinations_.empty()) {
+      start();
+      detail::insert(*stream_, std::forward<T>(value));
+    }
+    return *this;
+  }
+
+  /// @brief Adds a structured field
+  ///
+  /// Fields are stored with their type and encoded by structured sinks such
+  /// as cxxlog::structured_sink. Other destinations receive them as
+  /// ` key=value` pairs after the message.
+  /// @code {.cxx}
+  /// CXXLOG_I.kv("user", id).kv("elapsed", 0.25) << "logged in";
+  /// // 1647540198.640983 INFO  logged in user=42 elapsed=0.25
+  /// @endcode
+  /// @param[in] key - name of the field (up to 255 bytes)
+  /// @param[in] value - value of the field
+  template<typename T>
+  Logger& kv(const char *key, const T &value) {
+    return kv(key, std::strlen(key), value);
+  }
+
+  template<typename T>
+  Logger& kv(const std::string &key, const T &value) {
+    return kv(key.data(), key.size(), value);
+  }
+
+  /// @brief boolean conversion for short-circuit evaluation
+  /// @see CXXLOG
+  explicit operator bool() const {
+    return true;
+  }
+
+ private:
+  bool started() const {
+    return stream_->buffer.size() != 0 || !stream_->fields.empty();
+  }
+
+  template<typename T>
+  Logger& kv(const char *key, std::size_t key_size, const T &value) {
+    if (!destinations_.empty()) {
+      start();
+      detail::encode_field(&stream_->fields, key, key_size, value,
+          detail::insert_tag<detail::insert_traits<T>::value>());
+    }
+    return *this;
+  }
+
+  /// @brief Reads the time and writes the columns before the first value
+  void start() {
+    if (!started()) {
+      build_begin_ = detail::stats_clock();
+      time_ = col::precise_clock::now();
+      if (!columns_.empty()) {
+        const auto function =
+            (function_ != nullptr && *function_ != '\0') ? function_ : nullptr;
+        columns_.write({ stream_->out, severity_, time_, location_,
+            function, (function != nullptr) ? std::strlen(function) : 0 });
+      }
+      message_offset_ = stream_->buffer.size();
+    }
+  }
+
+  const severity_t severity_;
+  detail::record_stream *const stream_;
+  timestamp time_;
+  detail::destination_list destinations_;
+  detail::column_set columns_;
+  std::uint64_t suppressed_;
+  std::size_t message_offset_;
+  const source_location *location_;
+  const char *function_;
+  std::uint64_t build_begin_;
+};
+
+namespace detail {
+
+/// @brief Stand-in for cxxlog::Logger after a macro is stripped
+///
+/// Accepts the same calls as cxxlog::Logger and does nothing. It is only
+/// used in the body of `while (false)`, which the compiler discards.
+/// @see CXXLOG_STRIP_BELOW
+struct stripped_logger {
+  template<typename... Args>
+  stripped_logger& operator()(Args&&...) {
+    return *this;
+  }
+
+  template<typename... Args>
+  stripped_logger& cols(Args&&...) {
+    return *this;
+  }
+
+  template<typename... Columns>
+  stripped_logger& cols() {
+    return *this;
+  }
+
+  template<typename Key, typename T>
+  stripped_logger& kv(const Key&, const T&) {
+    return *this;
+  }
+
+  template<typename T>
+  stripped_logger& operator<<(const T&) {
+    return *this;
+  }
+
+  stripped_logger& operator<<(std::ostream& (*)(std::ostream&)) {
+    return *this;
+  }
+};
+
+}  // namespace detail
+
 }  // namespace cxxlog
 
+#if !CXXLOG_COMPILED_LIB
+#include "cxxlog/cxxlog_impl.hxx"
+#endif  // CXXLOG_COMPILED_LIB
+
 #endif  // CXXLOG_CXXLOG_HXX_
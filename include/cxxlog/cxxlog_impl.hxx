@@ -0,0 +1,139 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_CXXLOG_IMPL_HXX_
+#define CXXLOG_CXXLOG_IMPL_HXX_
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/backend.hxx"
+
+// Definitions of the functions declared with CXXLOG_API. This file is
+// included at the end of cxxlog/cxxlog.hxx, or compiled once into the
+// cxxlog_compiled library if CXXLOG_COMPILED_LIB is set.
+
+namespace cxxlog {
+
+namespace detail {
+
+CXXLOG_API std::string thread_id_text() {
+  std::ostringstream id;
+  id << std::hex << std::this_thread::get_id();
+  return id.str();
+}
+
+CXXLOG_API std::ostream* standard_output() {
+  return &std::cout;
+}
+
+CXXLOG_API void publish(const record &r, destination_list &&destinations) {
+  if (!thread_backend::instance().push(r, std::move(destinations)) &&
+      !async_backend::instance().push(r, std::move(destinations))) {
+    write_destinations(r, destinations);
+  }
+}
+
+CXXLOG_API bool background_running() {
+  return thread_backend::instance().running() ||
+      async_backend::instance().running();
+}
+
+CXXLOG_API void flush_pipeline(const destination_list &destinations) {
+  thread_backend::instance().flush();
+  async_backend::instance().flush();
+  for (const auto &d : destinations) {
+    flush_destination(d);
+  }
+  buffered_sinks<>::flush_all();
+}
+
+}  // namespace detail
+
+CXXLOG_API void start_async(const async_options &options) {
+  detail::async_backend::instance().start(options);
+}
+
+CXXLOG_API void stop_async() {
+  detail::async_backend::instance().stop();
+}
+
+CXXLOG_API void start_thread_buffers(const thread_buffer_options &options) {
+  detail::thread_backend::instance().start(options);
+}
+
+CXXLOG_API void stop_thread_buffers() {
+  detail::thread_backend::instance().stop();
+}
+
+CXXLOG_API void flush() {
+  detail::thread_backend::instance().flush();
+  detail::async_backend::instance().flush();
+}
+
+CXXLOG_API void start_flusher(std::chrono::milliseconds period) {
+  detail::periodic_flusher::instance().start(period);
+}
+
+CXXLOG_API void stop_flusher() {
+  detail::periodic_flusher::instance().stop();
+}
+
+CXXLOG_API std::size_t dropped_count() {
+  return detail::thread_backend::instance().dropped() +
+      detail::async_backend::instance().dropped();
+}
+
+CXXLOG_API stats_snapshot stats() {
+  stats_snapshot snapshot = stats_snapshot();
+#if CXXLOG_STATS
+  detail::stats_registry::instance().collect(&snapshot);
+#endif  // CXXLOG_STATS
+  snapshot.queued = detail::thread_backend::instance().queued() +
+      detail::async_backend::instance().queued();
+  snapshot.dropped = dropped_count();
+  const auto rings = detail::thread_backend::instance().pool();
+  const auto queue = detail::async_backend::instance().pool();
+  snapshot.pool_blocks = rings.first + queue.first;
+  snapshot.pool_block_size = std::max(rings.second, queue.second);
+  return snapshot;
+}
+
+CXXLOG_API Logger::~Logger() {
+  auto &buffer = stream_->buffer;
+  const auto &fields = stream_->fields;
+  if (!destinations_.empty() && started()) {
+    if (suppressed_ != 0) {
+      *this << " (" << suppressed_ << " suppressed)";
+    }
+    const auto message_size = buffer.size() - message_offset_;
+    const record fields_only(severity_, nullptr, 0, time_, 0, 0,
+        fields.data(), fields.size());
+    if (!fields.empty() && detail::needs_text(destinations_)) {
+      detail::append_logfmt_fields(buffer, fields_only, message_size != 0);
+    }
+    buffer.append("\n", 1);
+    const record r(severity_, buffer.data(), buffer.size(), time_,
+        message_offset_, message_size, fields.data(), fields.size());
+    detail::sink_stats::record(severity_, build_begin_);
+    if (severity_ == fatal) {
+      const auto destinations = destinations_;
+      detail::publish(r, std::move(destinations_));
+      detail::flush_pipeline(destinations);
+    } else {
+      detail::publish(r, std::move(destinations_));
+    }
+  }
+  detail::record_stream_pool::release(stream_);
+}
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_CXXLOG_IMPL_HXX_
@@ -0,0 +1,299 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_FILE_SINK_HXX_
+#define CXXLOG_FILE_SINK_HXX_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/structured.hxx"
+
+namespace cxxlog {
+
+namespace detail {
+
+/// @brief Opens a file for appending
+/// @return file descriptor, or -1 on failure
+inline int open_file(const char *path) {
+#if defined(_WIN32)
+  return _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY,
+      _S_IREAD | _S_IWRITE);
+#else
+  return ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+}
+
+inline void close_file(int fd) {
+#if defined(_WIN32)
+  _close(fd);
+#else
+  ::close(fd);
+#endif
+}
+
+/// @brief Current size of an open file
+inline std::uint64_t file_size(int fd) {
+#if defined(_WIN32)
+  struct _stat64 st;
+  return (fd >= 0 && _fstat64(fd, &st) == 0) ?
+      static_cast<std::uint64_t>(st.st_size) : 0;
+#else
+  struct stat st;
+  return (fd >= 0 && ::fstat(fd, &st) == 0) ?
+      static_cast<std::uint64_t>(st.st_size) : 0;
+#endif
+}
+
+/// @brief Writes two buffers with as few system calls as possible
+///
+/// Partial writes and interrupted calls are retried.
+/// @return false if the file could not be written
+inline bool write_file(int fd, const char *data1, std::size_t size1,
+    const char *data2 = nullptr, std::size_t size2 = 0) {
+#if defined(_WIN32)
+  const char *data[] = { data1, data2 };
+  std::size_t size[] = { size1, size2 };
+  for (int i = 0; i < 2; ++i) {
+    while (size[i] > 0) {
+      const auto n = _write(fd, data[i], static_cast<unsigned int>(size[i]));
+      if (n <= 0) {
+        return false;
+      }
+      data[i] += n;
+      size[i] -= static_cast<std::size_t>(n);
+    }
+  }
+  return true;
+#else
+  iovec iov[2] = {
+      { const_cast<char*>(data1), size1 },
+      { const_cast<char*>(data2), size2 },
+  };
+  int first = 0;
+  while (first < 2) {
+    if (iov[first].iov_len == 0) {
+      ++first;
+      continue;
+    }
+    const auto n = ::writev(fd, iov + first, 2 - first);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    auto written = static_cast<std::size_t>(n);
+    while (first < 2 && written >= iov[first].iov_len) {
+      written -= iov[first].iov_len;
+      iov[first].iov_len = 0;
+      ++first;
+    }
+    if (first < 2) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + written;
+      iov[first].iov_len -= written;
+    }
+  }
+  return true;
+#endif
+}
+
+}  // namespace detail
+
+/// @brief Options of cxxlog::file_sink
+struct file_options {
+  /// @brief Size of the write buffer in bytes
+  std::size_t buffer_size = 64 * 1024;
+  /// @brief Records at or above this severity are written immediately
+  severity_t flush_severity = error;
+  /// @brief Buffered records older than this are written by the next record
+  std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000);
+  /// @brief Encoding of the records
+  ///
+  /// JSON and logfmt records are encoded directly into the write buffer.
+  record_format format = record_format::text;
+};
+
+/// @brief Sink that appends records to a file in large batches
+///
+/// Records are accumulated in a buffer and written with a single system
+/// call when the buffer is full, when a record at or above
+/// `file_options::flush_severity` arrives, when `flush_interval` has passed,
+/// or when flush() is called. Records larger than the buffer are written
+/// together with the buffered data without being copied. The buffer is also
+/// written after each fatal record and by the handler installed with
+/// cxxlog::install_crash_handler().
+/// @code {.cxx}
+/// cxxlog::file_sink file("log.txt");
+/// CXXLOG_I(file) << "buffered";
+/// CXXLOG_E(file) << "written immediately with the buffered records";
+/// @endcode
+class file_sink : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] path - path of the file to append to
+  /// @param[in] options - buffering options
+  explicit file_sink(
+      const std::string &path, const file_options &options = file_options())
+      : options_(options),
+        fd_(detail::open_file(path.c_str())),
+        buffer_(options.buffer_size),
+        size_(0),
+        file_size_(detail::file_size(fd_)),
+        last_flush_(std::chrono::steady_clock::now()) {
+    detail::buffered_sinks<>::add(this, &file_sink::emergency_write);
+  }
+
+  file_sink(const file_sink&) = delete;
+  file_sink& operator=(const file_sink&) = delete;
+
+  /// @brief Destructor
+  ///
+  /// Writes the buffered records and closes the file.
+  ~file_sink() override {
+    detail::buffered_sinks<>::remove(this);
+    flush();
+    if (fd_ >= 0) {
+      detail::close_file(fd_);
+    }
+  }
+
+  /// @brief Whether the file has been opened
+  bool is_open() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fd_ >= 0;
+  }
+
+  void write(const record &r) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0) {
+      return;
+    }
+    if (options_.format != record_format::text) {
+      appender out { this };
+      detail::encode_record(out, r, options_.format);
+    } else if (r.size >= buffer_.size()) {
+      detail::write_file(fd_, buffer_.data(), size_, r.data, r.size);
+      file_size_ += r.size;
+      size_ = 0;
+      last_flush_ = std::chrono::steady_clock::now();
+    } else {
+      append_locked(r.data, r.size);
+    }
+    if ((r.severity != none && r.severity <= options_.flush_severity) ||
+        (std::chrono::steady_clock::now() - last_flush_ >=
+            options_.flush_interval)) {
+      flush_locked();
+    }
+    written_locked(r);
+  }
+
+  void flush() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_locked();
+  }
+
+  bool structured() const override {
+    return options_.format != record_format::text;
+  }
+
+ protected:
+  /// @brief Called after each record while the mutex is held
+  virtual void written_locked(const record&) {
+  }
+
+  std::mutex& mutex() {
+    return mutex_;
+  }
+
+  /// @brief Size of the file including the buffered records
+  std::uint64_t file_size_locked() const {
+    return file_size_;
+  }
+
+  /// @brief Writes the buffered records and continues with another file
+  /// @return the previous file descriptor, to be closed by the caller
+  int replace_file_locked(int fd) {
+    flush_locked();
+    const auto previous = fd_;
+    fd_ = fd;
+    file_size_ = detail::file_size(fd);
+    return previous;
+  }
+
+ private:
+  /// @brief Output of the encoders, writing into the buffer
+  struct appender {
+    file_sink *sink;
+
+    void append(const char *data, std::size_t size) {
+      sink->append_locked(data, size);
+    }
+  };
+
+  void append_locked(const char *data, std::size_t size) {
+    if (size_ + size > buffer_.size()) {
+      flush_locked();
+      if (size >= buffer_.size()) {
+        detail::write_file(fd_, data, size);
+        file_size_ += size;
+        return;
+      }
+    }
+    std::memcpy(buffer_.data() + size_, data, size);
+    size_ += size;
+    file_size_ += size;
+  }
+
+  /// @brief Writes the buffer without locking (crash handler)
+  static void emergency_write(
+      sink *s, detail::buffered_sinks<>::emergency_output) {
+    const auto self = static_cast<file_sink*>(s);
+    const auto size = self->size_;
+    if (self->fd_ >= 0 && size > 0 && size <= self->buffer_.size()) {
+      detail::write_file(self->fd_, self->buffer_.data(), size);
+    }
+  }
+
+  void flush_locked() {
+    if (fd_ >= 0 && size_ > 0) {
+      detail::write_file(fd_, buffer_.data(), size_);
+    }
+    size_ = 0;
+    last_flush_ = std::chrono::steady_clock::now();
+  }
+
+  const file_options options_;
+  int fd_;
+  mutable std::mutex mutex_;
+  std::vector<char> buffer_;
+  std::size_t size_;
+  std::uint64_t file_size_;
+  std::chrono::steady_clock::time_point last_flush_;
+};
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_FILE_SINK_HXX_
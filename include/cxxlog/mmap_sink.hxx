@@ -0,0 +1,214 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_MMAP_SINK_HXX_
+#define CXXLOG_MMAP_SINK_HXX_
+
+#if defined(_WIN32)
+#error "cxxlog/mmap_sink.hxx requires POSIX mmap"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cxxlog/cxxlog.hxx"
+
+namespace cxxlog {
+
+/// @brief Header at the beginning of a ring file
+///
+/// The data area follows the header. `cursor` counts every byte ever
+/// reserved, so the oldest byte still in the ring is at
+/// `cursor - capacity` once the ring has wrapped.
+struct ring_header {
+  /// @brief Identifies the file format
+  char magic[8];
+  /// @brief Format version
+  std::uint32_t version;
+  /// @brief Offset of the data area from the beginning of the file
+  std::uint32_t header_size;
+  /// @brief Size of the data area in bytes
+  std::uint64_t capacity;
+  /// @brief Total number of bytes written
+  std::atomic<std::uint64_t> cursor;
+  /// @brief Number of times the ring has wrapped around
+  std::atomic<std::uint64_t> generation;
+
+  static constexpr std::uint32_t current_version = 2;
+
+  static const char* expected_magic() {
+    return "CXXLOGR";
+  }
+
+  bool valid() const {
+    return std::memcmp(magic, expected_magic(), sizeof(magic)) == 0 &&
+        version == current_version && header_size == sizeof(ring_header);
+  }
+};
+
+/// @brief Layout of a record in the data area of a ring file
+///
+/// A record is an 8-byte commit tag, a 4-byte size and the bytes of the
+/// record, unaligned and possibly wrapping around the end of the data area.
+/// The writer stores the tag last, after the other bytes. It is derived
+/// from the position of the record in the stream (see ring_header::cursor),
+/// so a record torn by a crash, or the bytes left by an older lap of the
+/// ring, never look committed.
+struct ring_record {
+  static constexpr std::size_t header_size = 12;
+
+  /// @brief Commit tag of the record at the position
+  static std::uint64_t tag(std::uint64_t position) {
+    return position + 1;
+  }
+
+  /// @brief Copies bytes out of the data area from a stream position
+  static void read(const char *data, std::uint64_t capacity,
+      std::uint64_t position, void *out, std::size_t size) {
+    const auto offset = static_cast<std::size_t>(position % capacity);
+    const auto first = std::min<std::size_t>(
+        size, static_cast<std::size_t>(capacity) - offset);
+    std::memcpy(out, data + offset, first);
+    std::memcpy(static_cast<char*>(out) + first, data, size - first);
+  }
+};
+
+/// @brief Sink that copies records into a memory-mapped ring file
+///
+/// Writing a record reserves space with one atomic add and copies the bytes
+/// into a shared mapping, so no system call and no lock is involved. The
+/// kernel writes the pages back even if the process crashes, and the commit
+/// tag of each record (see cxxlog::ring_record) tells the records written
+/// in full from the ones a crash interrupted. Once the ring
+/// is full the oldest records are overwritten; records larger than the ring
+/// are discarded. An existing ring file of the same capacity is continued.
+///
+/// Use the `cxxlog_ring_dump` tool to print the ring in order.
+/// @code {.cxx}
+/// cxxlog::mmap_sink ring("log.ring", 16 * 1024 * 1024);
+/// CXXLOG_I(ring) << "crash-safe";
+/// @endcode
+class mmap_sink : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] path - path of the ring file
+  /// @param[in] capacity - size of the data area in bytes
+  mmap_sink(const std::string &path, std::size_t capacity)
+      : header_(nullptr), data_(nullptr), capacity_(capacity), size_(0) {
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    const bool reuse = (::fstat(fd, &st) == 0) &&
+        (static_cast<std::size_t>(st.st_size) ==
+            sizeof(ring_header) + capacity);
+    size_ = sizeof(ring_header) + capacity;
+    if (reuse || ::ftruncate(fd, static_cast<off_t>(size_)) == 0) {
+      void *mapping = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+          MAP_SHARED, fd, 0);
+      if (mapping != MAP_FAILED) {
+        init(mapping, reuse);
+      }
+    }
+    ::close(fd);
+  }
+
+  mmap_sink(const mmap_sink&) = delete;
+  mmap_sink& operator=(const mmap_sink&) = delete;
+
+  ~mmap_sink() override {
+    if (header_ != nullptr) {
+      ::munmap(header_, size_);
+    }
+  }
+
+  /// @brief Whether the ring file has been mapped
+  bool is_open() const {
+    return header_ != nullptr;
+  }
+
+  void write(const record &r) override {
+    const auto total = ring_record::header_size + r.size;
+    if (header_ == nullptr || total > capacity_ ||
+        r.size > std::numeric_limits<std::uint32_t>::max()) {
+      return;
+    }
+    const auto start = header_->cursor.fetch_add(
+        total, std::memory_order_relaxed);
+    const auto size = static_cast<std::uint32_t>(r.size);
+    copy(start + 8, &size, sizeof(size));
+    copy(start + ring_record::header_size, r.data, r.size);
+    // the tag must not reach the mapping before the bytes it commits
+    std::atomic_thread_fence(std::memory_order_release);
+    const auto tag = ring_record::tag(start);
+    copy(start, &tag, sizeof(tag));
+    if (static_cast<std::size_t>(start % capacity_) + total > capacity_) {
+      update_generation((start + total) / capacity_);
+    }
+  }
+
+  /// @brief Schedules the written pages to be written back
+  void flush() override {
+    if (header_ != nullptr) {
+      ::msync(header_, size_, MS_ASYNC);
+    }
+  }
+
+ private:
+  void init(void *mapping, bool reuse) {
+    auto header = static_cast<ring_header*>(mapping);
+    if (!reuse || !header->valid() || header->capacity != capacity_) {
+      std::memset(mapping, 0, size_);
+      header = new(mapping) ring_header();
+      std::memcpy(header->magic, ring_header::expected_magic(),
+          sizeof(header->magic));
+      header->version = ring_header::current_version;
+      header->header_size = sizeof(ring_header);
+      header->capacity = capacity_;
+      header->cursor.store(0, std::memory_order_relaxed);
+      header->generation.store(0, std::memory_order_relaxed);
+    }
+    header_ = header;
+    data_ = static_cast<char*>(mapping) + sizeof(ring_header);
+  }
+
+  void copy(std::uint64_t position, const void *data, std::size_t size) {
+    const auto offset = static_cast<std::size_t>(position % capacity_);
+    const auto first = std::min(size, capacity_ - offset);
+    std::memcpy(data_ + offset, data, first);
+    std::memcpy(data_, static_cast<const char*>(data) + first, size - first);
+  }
+
+  void update_generation(std::uint64_t generation) {
+    auto current = header_->generation.load(std::memory_order_relaxed);
+    while (current < generation &&
+           !header_->generation.compare_exchange_weak(
+               current, generation, std::memory_order_relaxed)) {
+    }
+  }
+
+  ring_header *header_;
+  char *data_;
+  const std::size_t capacity_;
+  std::size_t size_;
+};
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_MMAP_SINK_HXX_
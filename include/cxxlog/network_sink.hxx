@@ -0,0 +1,560 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_NETWORK_SINK_HXX_
+#define CXXLOG_NETWORK_SINK_HXX_
+
+#if defined(_WIN32)
+#error "cxxlog/network_sink.hxx requires POSIX sockets"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/structured.hxx"
+
+namespace cxxlog {
+
+/// @brief Header fields of RFC 5424 syslog messages
+struct syslog_options {
+  /// @brief Facility code (1: user-level messages, 16 to 23: local0-7)
+  int facility = 1;
+  /// @brief APP-NAME of the messages ("-" if empty)
+  std::string app_name;
+  /// @brief HOSTNAME of the messages (the host name if empty)
+  std::string host_name;
+};
+
+namespace detail {
+
+/// @brief Waits until a socket is ready for the events
+/// @return false if the timeout expired or the wait failed
+inline bool poll_socket(
+    int fd, short events, std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  for (;;) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    pollfd p { fd, events, 0 };
+    const auto n = ::poll(&p, 1, (left > 0) ? static_cast<int>(left) : 0);
+    if (n > 0) {
+      return true;
+    }
+    if (n == 0 || errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+/// @brief Connects a non-blocking socket of the given type to a host and a
+/// port
+///
+/// A TCP connection which is not established within the timeout fails.
+/// @return file descriptor, or -1 on failure
+inline int connect_socket(const std::string &host, std::uint16_t port,
+    int type, std::chrono::milliseconds timeout) {
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = type;
+  addrinfo *addresses = nullptr;
+  const auto service = std::to_string(port);
+  if (::getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (auto a = addresses; a != nullptr && fd < 0; a = a->ai_next) {
+    fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK,
+        a->ai_protocol);
+    if (fd < 0 || ::connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+      continue;
+    }
+    int error = errno;
+    if (error == EINPROGRESS && poll_socket(fd, POLLOUT, timeout)) {
+      socklen_t size = sizeof(error);
+      if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0) {
+        error = errno;
+      }
+    }
+    if (error != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  ::freeaddrinfo(addresses);
+  return fd;
+}
+
+/// @brief Builds RFC 5424 messages from records
+class syslog_encoder {
+ public:
+  explicit syslog_encoder(const syslog_options &options)
+      : facility_(options.facility),
+        app_name_(options.app_name.empty() ? "-" : options.app_name),
+        host_name_(options.host_name),
+        process_id_(process_id_text()) {
+    if (host_name_.empty()) {
+      char name[256] = {};
+      host_name_ = (::gethostname(name, sizeof(name) - 1) == 0 && name[0]) ?
+          name : "-";
+    }
+  }
+
+  /// @brief Appends `<PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID - SD MSG`
+  ///
+  /// The fields of the record become the parameters of a `cxxlog` element.
+  template<typename Out>
+  void encode(Out &out, const record &r) const {
+    char head[48];
+    auto end = head;
+    *end++ = '<';
+    end = format_uint(end, static_cast<std::uint64_t>(
+        facility_ * 8 + syslog_severity(r.severity)), 0);
+    *end++ = '>';
+    *end++ = '1';
+    *end++ = ' ';
+    end = format_record_time(r.time, end);
+    *end++ = ' ';
+    out.append(head, static_cast<std::size_t>(end - head));
+    out.append(host_name_.data(), host_name_.size());
+    out.append(" ", 1);
+    out.append(app_name_.data(), app_name_.size());
+    out.append(" ", 1);
+    out.append(process_id_.data(), process_id_.size());
+    out.append(" - ", 3);
+    if (r.fields_size == 0) {
+      out.append("-", 1);
+    } else {
+      out.append("[cxxlog@32473", 13);
+      for_each_field(r, [&out](const field &f) {
+        out.append(" ", 1);
+        append_param_name(out, f.key, f.key_size);
+        out.append("=\"", 2);
+        if (f.type == field_type::string) {
+          append_param_value(out, f.text, f.text_size);
+        } else {
+          append_field_number(out, f);
+        }
+        out.append("\"", 1);
+      });
+      out.append("]", 1);
+    }
+    if (r.message_size != 0) {
+      out.append(" ", 1);
+      out.append(r.data + r.message_offset, r.message_size);
+    }
+  }
+
+ private:
+  static int syslog_severity(severity_t severity) {
+    // emergency, alert, critical, error, warning, notice, info, debug
+    static const int codes[] = { 7, 2, 3, 4, 6, 7, 7 };
+    return codes[severity];
+  }
+
+  /// @brief Appends a PARAM-NAME of RFC 5424: at most 32 printable ASCII
+  /// characters other than `=`, space, `]` and `"`, replaced by `_`
+  template<typename Out>
+  static void append_param_name(Out &out, const char *key, std::size_t n) {
+    char name[32];
+    const auto size = std::min(n, sizeof(name));
+    for (std::size_t i = 0; i < size; ++i) {
+      const auto ch = static_cast<unsigned char>(key[i]);
+      name[i] = (ch > ' ' && ch < 0x7f && ch != '=' && ch != ']' &&
+          ch != '"') ? key[i] : '_';
+    }
+    if (size == 0) {
+      out.append("_", 1);
+    } else {
+      out.append(name, size);
+    }
+  }
+
+  /// @brief Escapes `"`, `\` and `]` as required by RFC 5424
+  template<typename Out>
+  static void append_param_value(Out &out, const char *text, std::size_t n) {
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (text[i] == '"' || text[i] == '\\' || text[i] == ']') {
+        out.append(text + begin, i - begin);
+        out.append("\\", 1);
+        begin = i;
+      }
+    }
+    out.append(text + begin, n - begin);
+  }
+
+  const int facility_;
+  const std::string app_name_;
+  std::string host_name_;
+  const std::string process_id_;
+};
+
+}  // namespace detail
+
+/// @brief Sink that sends records as RFC 5424 syslog datagrams over UDP
+///
+/// Each record is one datagram sent with a non-blocking call on the logging
+/// thread (or the writer thread of a background backend), so a missing or
+/// slow collector never blocks the program. Datagrams the kernel cannot
+/// queue are dropped and counted.
+/// @code {.cxx}
+/// cxxlog::syslog_options syslog;
+/// syslog.app_name = "server";
+/// cxxlog::udp_syslog_sink collector("logs.example.com", 514, syslog);
+/// CXXLOG_E(collector).kv("port", 8080) << "bind failed";
+/// // <11>1 2022-03-17T18:03:18.640983Z host server 12345 -
+/// //   [cxxlog@32473 port="8080"] bind failed
+/// @endcode
+class udp_syslog_sink : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] host - name or address of the collector
+  /// @param[in] port - UDP port of the collector
+  /// @param[in] options - header fields of the messages
+  /// @param[in] max_size - longer messages are truncated
+  udp_syslog_sink(const std::string &host, std::uint16_t port = 514,
+      const syslog_options &options = syslog_options(),
+      std::size_t max_size = 2048)
+      : encoder_(options),
+        max_size_(max_size),
+        fd_(detail::connect_socket(
+            host, port, SOCK_DGRAM, std::chrono::milliseconds(0))),
+        dropped_(0) {
+  }
+
+  udp_syslog_sink(const udp_syslog_sink&) = delete;
+  udp_syslog_sink& operator=(const udp_syslog_sink&) = delete;
+
+  ~udp_syslog_sink() override {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  /// @brief Whether the socket has been created
+  bool is_open() const {
+    return fd_ >= 0;
+  }
+
+  void write(const record &r) override {
+    if (fd_ < 0) {
+      return;
+    }
+    static thread_local detail::record_buffer buffer;
+    buffer.clear();
+    encoder_.encode(buffer, r);
+    const auto size = std::min(buffer.size(), max_size_);
+    if (::send(fd_, buffer.data(), size, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  bool structured() const override {
+    return true;
+  }
+
+  /// @brief Number of datagrams that could not be sent
+  std::size_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const detail::syslog_encoder encoder_;
+  const std::size_t max_size_;
+  const int fd_;
+  std::atomic<std::size_t> dropped_;
+};
+
+/// @brief Options of cxxlog::tcp_sink
+struct tcp_options {
+  /// @brief Bytes gathered before a batch is sent
+  std::size_t batch_size = 64 * 1024;
+  /// @brief Records waiting longer than this are sent without a full batch
+  std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100);
+  /// @brief Bytes kept while the connection is down; newer records are
+  /// dropped once it is full
+  std::size_t buffer_size = 8 * 1024 * 1024;
+  /// @brief Delay between connection attempts
+  std::chrono::milliseconds reconnect_interval =
+      std::chrono::milliseconds(1000);
+  /// @brief A connection attempt, or a send to a collector that stopped
+  /// reading, fails after this long and the connection is retried
+  std::chrono::milliseconds io_timeout = std::chrono::milliseconds(5000);
+  /// @brief Encoding of the records, one per line
+  record_format format = record_format::text;
+  /// @brief Sends RFC 5424 messages with octet-counting framing (RFC 6587)
+  /// instead of lines
+  bool syslog = false;
+  /// @brief Header fields of the messages if `syslog` is set
+  syslog_options syslog_header;
+};
+
+/// @brief Sink that forwards records over TCP in large batches
+///
+/// Logging threads append encoded records to a bounded buffer and return.
+/// A background thread connects, sends the buffer in one large write once
+/// `tcp_options::batch_size` bytes are gathered or `flush_interval` has
+/// passed, and reconnects after a failure. While
+/// the collector is unreachable, records accumulate up to
+/// `tcp_options::buffer_size` bytes and newer ones are dropped, so
+/// producers never block on the network. A record cut by a failed send is
+/// sent again in full after reconnecting. The socket is non-blocking, so
+/// the sender thread notices a stop request within
+/// `tcp_options::io_timeout` even if the collector does not answer.
+/// @code {.cxx}
+/// cxxlog::tcp_options options;
+/// options.format = cxxlog::record_format::json;
+/// cxxlog::tcp_sink collector("logs.example.com", 5170, options);
+/// CXXLOG_I(collector) << "forwarded";
+/// @endcode
+class tcp_sink : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] host - name or address of the collector
+  /// @param[in] port - TCP port of the collector
+  /// @param[in] options - batching, buffering and encoding options
+  tcp_sink(const std::string &host, std::uint16_t port,
+      const tcp_options &options = tcp_options())
+      : host_(host),
+        port_(port),
+        options_(options),
+        encoder_(options.syslog_header),
+        fd_(-1),
+        sent_(0),
+        in_flight_(0),
+        connected_(true),
+        flush_requested_(false),
+        stopping_(false),
+        dropped_(0) {
+    pending_.reserve(options.batch_size);
+    sender_ = std::thread(&tcp_sink::run, this);
+  }
+
+  tcp_sink(const tcp_sink&) = delete;
+  tcp_sink& operator=(const tcp_sink&) = delete;
+
+  /// @brief Destructor
+  ///
+  /// Sends what is buffered if the collector is reachable, waiting at most
+  /// `tcp_options::io_timeout` for a stalled connection.
+  ~tcp_sink() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_cv_.notify_one();
+    sender_.join();
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  void write(const record &r) override {
+    static thread_local detail::record_buffer buffer;
+    buffer.clear();
+    if (options_.syslog) {
+      encoder_.encode(buffer, r);
+    } else {
+      detail::encode_record(buffer, r, options_.format);
+    }
+    char frame[24];
+    std::size_t frame_size = 0;
+    if (options_.syslog) {
+      const auto end = detail::format_uint(
+          frame, static_cast<std::uint64_t>(buffer.size()), 0);
+      *end = ' ';
+      frame_size = static_cast<std::size_t>(end - frame) + 1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto total = frame_size + buffer.size();
+    if (pending_.size() + in_flight_ + total > options_.buffer_size) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pending_.insert(pending_.end(), frame, frame + frame_size);
+    pending_.insert(pending_.end(), buffer.data(),
+        buffer.data() + buffer.size());
+    if (pending_.size() >= options_.batch_size) {
+      wake_cv_.notify_one();
+    }
+  }
+
+  /// @brief Waits until the buffered records are sent, unless the
+  /// collector is unreachable
+  void flush() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while ((!pending_.empty() || in_flight_ != 0) &&
+           connected_.load(std::memory_order_relaxed)) {
+      flush_requested_ = true;
+      wake_cv_.notify_one();
+      idle_cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+  }
+
+  bool structured() const override {
+    return options_.syslog || options_.format != record_format::text;
+  }
+
+  /// @brief Whether the last connection attempt and send succeeded
+  bool connected() const {
+    return connected_.load(std::memory_order_relaxed);
+  }
+
+  /// @brief Number of records dropped because the buffer was full
+  std::size_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /// @brief Sends `sending_` from `sent_`
+  /// @return false if the connection failed
+  bool send_batch() {
+    while (sent_ < sending_.size()) {
+      const auto n = ::send(fd_, sending_.data() + sent_,
+          sending_.size() - sent_, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (!detail::poll_socket(fd_, POLLOUT, options_.io_timeout)) {
+          return false;
+        }
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      sent_ += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  /// @brief Moves `sent_` back to the beginning of the record it cuts
+  void rewind_partial_record() {
+    if (options_.syslog) {
+      // octet counting: walk the frames from the start of the batch
+      std::size_t begin = 0;
+      while (begin < sending_.size()) {
+        std::size_t size = 0;
+        auto p = begin;
+        while (p < sending_.size() && sending_[p] != ' ') {
+          size = size * 10 + static_cast<std::size_t>(sending_[p++] - '0');
+        }
+        const auto end = p + 1 + size;
+        if (end > sent_) {
+          break;
+        }
+        begin = end;
+      }
+      sent_ = begin;
+    } else {
+      while (sent_ > 0 && sending_[sent_ - 1] != '\n') {
+        --sent_;
+      }
+    }
+  }
+
+  void disconnect() {
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      if (sending_.empty()) {
+        wake_cv_.wait_for(lock, options_.flush_interval, [this] {
+          return stopping_ || flush_requested_ ||
+              pending_.size() >= options_.batch_size;
+        });
+        flush_requested_ = false;
+        if (pending_.empty()) {
+          idle_cv_.notify_all();
+          if (stopping_) {
+            return;
+          }
+          continue;
+        }
+        sending_.swap(pending_);
+        sent_ = 0;
+        in_flight_ = sending_.size();
+      }
+      lock.unlock();
+
+      if (fd_ < 0) {
+        fd_ = detail::connect_socket(
+            host_, port_, SOCK_STREAM, options_.io_timeout);
+      }
+      const bool sent = fd_ >= 0 && send_batch();
+      if (!sent && fd_ >= 0) {
+        disconnect();
+        rewind_partial_record();
+      }
+      connected_.store(sent, std::memory_order_relaxed);
+
+      lock.lock();
+      if (sent) {
+        sending_.clear();
+        in_flight_ = 0;
+        idle_cv_.notify_all();
+      } else {
+        in_flight_ = sending_.size() - sent_;
+        idle_cv_.notify_all();
+        if (stopping_) {
+          return;
+        }
+        wake_cv_.wait_for(lock, options_.reconnect_interval,
+            [this] { return stopping_; });
+      }
+    }
+  }
+
+  const std::string host_;
+  const std::uint16_t port_;
+  const tcp_options options_;
+  const detail::syslog_encoder encoder_;
+  int fd_;
+  std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable idle_cv_;
+  /// @brief Records appended by the logging threads
+  std::vector<char> pending_;
+  /// @brief Batch owned by the sender thread
+  std::vector<char> sending_;
+  std::size_t sent_;
+  std::size_t in_flight_;
+  /// @brief Cleared by a failed connection attempt or send
+  std::atomic<bool> connected_;
+  /// @brief Set by flush() to send the pending records without waiting
+  /// for a full batch
+  bool flush_requested_;
+  bool stopping_;
+  std::atomic<std::size_t> dropped_;
+  std::thread sender_;
+};
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_NETWORK_SINK_HXX_
@@ -0,0 +1,229 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_ROTATING_FILE_SINK_HXX_
+#define CXXLOG_ROTATING_FILE_SINK_HXX_
+
+#if defined(_WIN32)
+#error "cxxlog/rotating_file_sink.hxx requires POSIX rename of open files"
+#endif
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "cxxlog/cxxlog.hxx"
+#include "cxxlog/file_sink.hxx"
+
+namespace cxxlog {
+
+/// @brief Time-based rotation of cxxlog::rotating_file_sink
+enum class rotation_period {
+  /// @brief Rotated only by size
+  none,
+  /// @brief Rotated at the beginning of every hour (local time)
+  hourly,
+  /// @brief Rotated at every local midnight
+  daily,
+};
+
+/// @brief Options of cxxlog::rotating_file_sink
+struct rotation_options {
+  /// @brief The file is rotated once it reaches this size (0: no limit)
+  std::uint64_t max_size = 64 * 1024 * 1024;
+  /// @brief The file is also rotated at each period boundary
+  rotation_period period = rotation_period::none;
+  /// @brief Number of rotated files kept (`log.txt.1` ... `log.txt.<keep>`)
+  std::size_t keep = 7;
+  /// @brief Shell command compressing a rotated file, e.g. `gzip -f`
+  ///
+  /// The quoted path of the rotated file is appended. The command must
+  /// replace the file by one with `compress_extension` appended.
+  std::string compress_command;
+  /// @brief File name suffix produced by `compress_command`, e.g. `.gz`
+  std::string compress_extension;
+};
+
+/// @brief cxxlog::file_sink that rotates its file by size and time
+///
+/// Writers only compare the file size and the record time against the
+/// limits. Renaming the rotated files, opening the new file and running
+/// the compression command happen on a background thread; the writers
+/// keep appending to the old file until the new one is swapped in, so they
+/// never wait for the file system or the compressor.
+/// @code {.cxx}
+/// cxxlog::rotation_options rotation;
+/// rotation.max_size = 16 * 1024 * 1024;
+/// rotation.period = cxxlog::rotation_period::daily;
+/// rotation.keep = 14;
+/// rotation.compress_command = "gzip -f";
+/// rotation.compress_extension = ".gz";
+/// cxxlog::rotating_file_sink file("log.txt", rotation);
+/// CXXLOG_I(file) << "rotated in the background";
+/// @endcode
+class rotating_file_sink : public file_sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] path - path of the active file
+  /// @param[in] rotation - rotation options
+  /// @param[in] options - buffering options
+  rotating_file_sink(const std::string &path,
+      const rotation_options &rotation,
+      const file_options &options = file_options())
+      : file_sink(path, options),
+        path_(path),
+        rotation_(rotation),
+        next_rotation_(next_boundary(std::time(nullptr))),
+        requested_(false),
+        stopping_(false) {
+    rotator_ = std::thread(&rotating_file_sink::run, this);
+  }
+
+  /// @brief Destructor
+  ///
+  /// Waits for a rotation in progress, then writes the buffered records.
+  ~rotating_file_sink() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex());
+      stopping_ = true;
+    }
+    condition_.notify_one();
+    rotator_.join();
+  }
+
+  /// @brief Requests a rotation regardless of the limits
+  void rotate() {
+    {
+      std::lock_guard<std::mutex> lock(mutex());
+      requested_ = true;
+    }
+    condition_.notify_one();
+  }
+
+ protected:
+  void written_locked(const record &r) override {
+    if (requested_) {
+      return;
+    }
+    if ((rotation_.max_size != 0 &&
+         file_size_locked() >= rotation_.max_size) ||
+        (next_rotation_ != 0 && r.time.seconds >= next_rotation_)) {
+      requested_ = true;
+      condition_.notify_one();
+    }
+  }
+
+ private:
+  /// @brief Start of the next period in seconds since the epoch (0: none)
+  std::int64_t next_boundary(std::time_t now) const {
+    if (rotation_.period == rotation_period::none) {
+      return 0;
+    }
+    std::tm tm {};
+    detail::to_calendar(now, true, &tm);
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    if (rotation_.period == rotation_period::daily) {
+      tm.tm_hour = 0;
+      tm.tm_mday += 1;
+    } else {
+      tm.tm_hour += 1;
+    }
+    tm.tm_isdst = -1;
+    return static_cast<std::int64_t>(std::mktime(&tm));
+  }
+
+  std::string segment(std::size_t index, bool compressed) const {
+    return path_ + '.' + std::to_string(index) +
+        (compressed ? rotation_.compress_extension : std::string());
+  }
+
+  /// @brief Renames `path.N` to `path.N+1`, dropping the oldest
+  void shift_segments() const {
+    const bool compressed = !rotation_.compress_extension.empty();
+    std::remove(segment(rotation_.keep, false).c_str());
+    if (compressed) {
+      std::remove(segment(rotation_.keep, true).c_str());
+    }
+    for (auto i = rotation_.keep; i > 1; --i) {
+      std::rename(segment(i - 1, false).c_str(), segment(i, false).c_str());
+      if (compressed) {
+        std::rename(segment(i - 1, true).c_str(), segment(i, true).c_str());
+      }
+    }
+  }
+
+  void compress(const std::string &file) const {
+    if (rotation_.compress_command.empty()) {
+      return;
+    }
+    std::string quoted = "'";
+    for (const auto ch : file) {
+      if (ch == '\'') {
+        quoted += "'\\''";
+      } else {
+        quoted += ch;
+      }
+    }
+    quoted += '\'';
+    const auto status =
+        std::system((rotation_.compress_command + ' ' + quoted).c_str());
+    static_cast<void>(status);
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex());
+    while (true) {
+      condition_.wait(lock, [this] { return requested_ || stopping_; });
+      if (stopping_) {
+        break;
+      }
+      lock.unlock();
+
+      // writers keep appending to the renamed file until the swap below
+      const auto rotated = segment(1, false);
+      if (rotation_.keep > 0) {
+        shift_segments();
+        std::rename(path_.c_str(), rotated.c_str());
+      } else {
+        std::remove(path_.c_str());
+      }
+      const int fd = detail::open_file(path_.c_str());
+
+      lock.lock();
+      const int previous = (fd >= 0) ? replace_file_locked(fd) : -1;
+      next_rotation_ = next_boundary(std::time(nullptr));
+      requested_ = false;
+      lock.unlock();
+
+      if (previous >= 0) {
+        detail::close_file(previous);
+      }
+      if (rotation_.keep > 0) {
+        compress(rotated);
+      }
+      lock.lock();
+    }
+  }
+
+  const std::string path_;
+  const rotation_options rotation_;
+  std::int64_t next_rotation_;
+  bool requested_;
+  bool stopping_;
+  std::condition_variable condition_;
+  std::thread rotator_;
+};
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_ROTATING_FILE_SINK_HXX_
@@ -0,0 +1,207 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+#ifndef CXXLOG_STRUCTURED_HXX_
+#define CXXLOG_STRUCTURED_HXX_
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "cxxlog/cxxlog.hxx"
+
+namespace cxxlog {
+
+/// @brief Encoding of the records written by a sink
+enum class record_format {
+  /// @brief The formatted line, columns included
+  text,
+  /// @brief One JSON object per line
+  json,
+  /// @brief One line of logfmt `key=value` pairs
+  logfmt,
+};
+
+namespace detail {
+
+/// @brief Writes the time of a record as `2022-03-17T18:03:18.640983Z`
+/// @return end of the text (at most 27 characters)
+inline char* format_record_time(const timestamp &time, char *out) {
+  static thread_local second_cache cache = { -1, 0, {} };
+  if (time.seconds != cache.seconds) {
+    cache.size = static_cast<std::size_t>(
+        col::iso8601::format_calendar(time.seconds, false, 'T', cache.text) -
+        cache.text);
+    cache.seconds = time.seconds;
+  }
+  std::memcpy(out, cache.text, cache.size);
+  out += cache.size;
+  *out++ = '.';
+  out = format_uint(out, time.microseconds, 6);
+  *out++ = 'Z';
+  return out;
+}
+
+/// @brief Name of a severity without the padding of the severity column
+inline std::size_t severity_name(severity_t severity, const char **name) {
+  *name = severity_string(severity);
+  std::size_t size = 5;
+  while (size > 0 && (*name)[size - 1] == ' ') {
+    --size;
+  }
+  return size;
+}
+
+/// @brief Appends a quoted and escaped JSON string
+template<typename Out>
+void append_json_string(Out &out, const char *text, std::size_t size) {
+  static const char digits[] = "0123456789abcdef";
+  out.append("\"", 1);
+  std::size_t begin = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    const auto ch = static_cast<unsigned char>(text[i]);
+    if (ch >= ' ' && ch != '"' && ch != '\\') {
+      continue;
+    }
+    out.append(text + begin, i - begin);
+    const char *escaped =
+        (ch == '"') ? "\\\"" : (ch == '\\') ? "\\\\" :
+        (ch == '\n') ? "\\n" : (ch == '\r') ? "\\r" :
+        (ch == '\t') ? "\\t" : nullptr;
+    if (escaped != nullptr) {
+      out.append(escaped, 2);
+    } else {
+      const char unicode[] = {
+          '\\', 'u', '0', '0', digits[ch >> 4], digits[ch & 0xf] };
+      out.append(unicode, sizeof(unicode));
+    }
+    begin = i + 1;
+  }
+  out.append(text + begin, size - begin);
+  out.append("\"", 1);
+}
+
+/// @brief Encodes a record as a JSON object and a newline
+///
+/// The time, the severity and the message come first, followed by the
+/// fields in the order they were added. Non-finite numbers become `null`.
+template<typename Out>
+void encode_json(Out &out, const record &r) {
+  char time[32];
+  const char *severity;
+  const auto severity_size = severity_name(r.severity, &severity);
+  out.append("{\"time\":\"", 9);
+  out.append(time, static_cast<std::size_t>(
+      format_record_time(r.time, time) - time));
+  out.append("\",\"severity\":", 13);
+  append_json_string(out, severity, severity_size);
+  out.append(",\"message\":", 11);
+  append_json_string(out, r.data + r.message_offset, r.message_size);
+  for_each_field(r, [&out](const field &f) {
+    out.append(",", 1);
+    append_json_string(out, f.key, f.key_size);
+    out.append(":", 1);
+    if (f.type == field_type::string) {
+      append_json_string(out, f.text, f.text_size);
+    } else if (f.type == field_type::floating && !std::isfinite(f.floating)) {
+      out.append("null", 4);
+    } else {
+      append_field_number(out, f);
+    }
+  });
+  out.append("}\n", 2);
+}
+
+/// @brief Encodes a record as logfmt pairs and a newline
+template<typename Out>
+void encode_logfmt(Out &out, const record &r) {
+  char time[32];
+  const char *severity;
+  const auto severity_size = severity_name(r.severity, &severity);
+  out.append("time=", 5);
+  out.append(time, static_cast<std::size_t>(
+      format_record_time(r.time, time) - time));
+  out.append(" severity=", 10);
+  out.append(severity, severity_size);
+  out.append(" message=", 9);
+  append_logfmt_string(out, r.data + r.message_offset, r.message_size);
+  append_logfmt_fields(out, r, true);
+  out.append("\n", 1);
+}
+
+template<typename Out>
+void encode_record(Out &out, const record &r, record_format format) {
+  switch (format) {
+    case record_format::json:
+      encode_json(out, r);
+      break;
+    case record_format::logfmt:
+      encode_logfmt(out, r);
+      break;
+    case record_format::text:
+      out.append(r.data, r.size);
+      break;
+  }
+}
+
+}  // namespace detail
+
+/// @brief Sink that encodes records as JSON or logfmt lines
+///
+/// The column text is replaced by `time` and `severity` fields, followed by
+/// the message and the fields added by cxxlog::Logger::kv(). Encoding
+/// happens on the thread calling write(), which is the writer thread when a
+/// background backend is running. cxxlog::file_sink can also encode by
+/// itself with cxxlog::file_options::format.
+/// @code {.cxx}
+/// cxxlog::structured_sink json(cxxlog::record_format::json, std::cout);
+/// CXXLOG_I(json).kv("user", "alice").kv("id", 42) << "logged in";
+/// // {"time":"2022-03-17T18:03:18.640983Z","severity":"INFO",
+/// //  "message":"logged in","user":"alice","id":42}
+/// @endcode
+class structured_sink : public sink {
+ public:
+  /// @brief Constructor
+  /// @param[in] format - encoding of the records
+  /// @param[in] out - output stream or cxxlog::sink receiving the lines
+  template<typename Output>
+  structured_sink(record_format format, Output &&out)
+      : format_(format),
+        out_(detail::make_destination(
+            detail::to_ptr(std::forward<Output>(out)))) {
+  }
+
+  void write(const record &r) override {
+    static thread_local detail::record_buffer buffer;
+    buffer.clear();
+    detail::encode_record(buffer, r, format_);
+    detail::write_destination(
+        { r.severity, buffer.data(), buffer.size(), r.time }, out_);
+  }
+
+  void flush() override {
+    if (out_.sink != nullptr) {
+      out_.sink->flush();
+    } else if (out_.stream != nullptr) {
+      out_.stream->flush();
+    }
+  }
+
+  bool structured() const override {
+    return format_ != record_format::text;
+  }
+
+ private:
+  const record_format format_;
+  const detail::destination out_;
+};
+
+}  // namespace cxxlog
+
+#endif  // CXXLOG_STRUCTURED_HXX_
@@ -0,0 +1,10 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// @file
+///
+// The backend of the cxxlog_compiled library, built with
+// CXXLOG_COMPILED_LIB=1 so that its functions are defined once here.
+#include "cxxlog/cxxlog_impl.hxx"
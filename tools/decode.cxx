@@ -0,0 +1,533 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// Prints binary logs written by cxxlog::binary::writer as text.
+///
+/// The files are mapped into memory and cut into chunks of whole frames.
+/// The chunks are decoded and sorted in parallel, then the records of all
+/// files are merged by timestamp.
+///
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "cxxlog/binary.hxx"
+
+namespace {
+
+/// Frames are decoded in chunks of about this size.
+constexpr std::size_t chunk_size = 4 * 1024 * 1024;
+
+struct options {
+  cxxlog::severity_t severity = cxxlog::verbose;
+  std::int64_t since = std::numeric_limits<std::int64_t>::min();
+  std::int64_t until = std::numeric_limits<std::int64_t>::max();
+  long long thread = -1;
+  unsigned jobs = 0;
+  std::vector<const char*> files;
+};
+
+/// Read-only contents of a whole file.
+class mapped_file {
+ public:
+  explicit mapped_file(const char *path)
+      : data_(nullptr), size_(0), open_(false) {
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary);
+    if (file) {
+      copy_.assign(std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>());
+      data_ = copy_.data();
+      size_ = copy_.size();
+      open_ = true;
+    }
+#else
+    const int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && ::fstat(fd, &st) == 0) {
+      size_ = static_cast<std::size_t>(st.st_size);
+      open_ = true;
+      if (size_ != 0) {
+        void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+          ::madvise(mapping, size_, MADV_SEQUENTIAL);
+          data_ = static_cast<const char*>(mapping);
+        } else {
+          open_ = false;
+        }
+      }
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() {
+#if !defined(_WIN32)
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+  }
+
+  bool is_open() const {
+    return open_;
+  }
+
+  const char* data() const {
+    return data_;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+ private:
+  const char *data_;
+  std::size_t size_;
+  bool open_;
+#if defined(_WIN32)
+  std::vector<char> copy_;
+#endif
+};
+
+/// Frames of a file decoded by one task.
+struct chunk {
+  const char *data;
+  std::size_t size;
+  /// Sites defined before the chunk, shared by the following chunks until
+  /// another site is defined.
+  std::shared_ptr<const cxxlog::binary::decoder> sites;
+  std::int64_t first;
+  std::int64_t last;
+};
+
+/// Text lines of a chunk which pass the filters, sorted by timestamp.
+struct decoded {
+  struct line {
+    std::int64_t timestamp;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  std::vector<line> lines;
+  std::string text;
+};
+
+/// Size of the frame at `pos` if it can have been written by
+/// cxxlog::binary::writer and lies within the data, otherwise 0.
+std::size_t frame_at(const char *data, std::size_t size, std::size_t pos) {
+  using namespace cxxlog::binary;
+  const auto n = frame_size(data + pos, size - pos);
+  if (n == 0) {
+    return 0;
+  }
+  const auto payload = data + pos + frame_header_size;
+  switch (static_cast<std::uint8_t>(data[pos])) {
+    case session_frame:
+      return (n >= frame_header_size + 8 &&
+          std::memcmp(payload, writer::magic(), 8) == 0) ? n : 0;
+    case site_frame:
+      return (n >= frame_header_size + 17) ? n : 0;
+    case record_frame:
+      return (n >= record_header_size) ? n : 0;
+    default:
+      return 0;
+  }
+}
+
+/// Whether the bytes at `pos` can be the header of a frame cut by the end
+/// of the data, as left by a crash.
+bool truncated_at(const char *data, std::size_t size, std::size_t pos) {
+  using namespace cxxlog::binary;
+  if (size - pos < frame_header_size) {
+    return true;
+  }
+  const std::size_t n =
+      cxxlog::detail::get_raw<std::uint32_t>(data + pos + 1);
+  return static_cast<std::uint8_t>(data[pos]) <= record_frame &&
+      n > size - pos - frame_header_size && n <= chunk_size;
+}
+
+/// Number of frames in a row a frame must start to be trusted, so that a
+/// corrupt size is unlikely to land on something looking like a frame.
+constexpr int chain_length = 4;
+
+/// Whether `chain_length` plausible frames follow one another from `pos`.
+/// The end of the data, or a frame cut by it, completes the chain.
+bool chained(const char *data, std::size_t size, std::size_t pos) {
+  for (int i = 0; i < chain_length; ++i) {
+    if (pos == size || (i != 0 && truncated_at(data, size, pos))) {
+      return true;
+    }
+    const auto n = frame_at(data, size, pos);
+    if (n == 0) {
+      return false;
+    }
+    pos += n;
+  }
+  return true;
+}
+
+/// Position of the first trusted frame after `pos`, or `size` if there is
+/// none (e.g. within the truncated end of the file).
+std::size_t resync(const char *data, std::size_t size, std::size_t pos) {
+  for (++pos; pos < size; ++pos) {
+    if (chained(data, size, pos)) {
+      return pos;
+    }
+  }
+  return size;
+}
+
+/// Cuts a file into chunks of whole frames, reading only the frame headers
+/// and the timestamps of the records.
+///
+/// A file may be damaged, e.g. by a crash or a partial copy. A frame is
+/// trusted only if its header is plausible and so are the headers of the
+/// frames after it, so a corrupt size cannot swallow the following frames.
+/// Damaged bytes end the current chunk and are skipped up to the next
+/// trusted frame.
+std::vector<chunk> split(const mapped_file &mapped) {
+  std::vector<chunk> chunks;
+  cxxlog::binary::decoder sites;
+  std::shared_ptr<const cxxlog::binary::decoder> snapshot;
+  const auto data = mapped.data();
+  const auto size = mapped.size();
+  std::size_t pos = 0;
+  while (pos < size) {
+    // the frames of the chunk, at least one even if larger than a chunk
+    std::size_t end = pos;
+    bool damaged = false;
+    while (end < size && (end == pos || end - pos < chunk_size)) {
+      if (!chained(data, size, end)) {
+        damaged = true;
+        break;
+      }
+      end += frame_at(data, size, end);
+    }
+    if (end != pos) {
+      if (!snapshot || snapshot->revision() != sites.revision()) {
+        snapshot = std::make_shared<const cxxlog::binary::decoder>(sites);
+      }
+      chunk c { data + pos, end - pos, snapshot,
+          std::numeric_limits<std::int64_t>::max(),
+          std::numeric_limits<std::int64_t>::min() };
+      sites.decode(c.data, c.size, [&c](const cxxlog::binary::entry &e) {
+        c.first = std::min(c.first, e.timestamp);
+        c.last = std::max(c.last, e.timestamp);
+      });
+      chunks.push_back(std::move(c));
+    }
+    pos = damaged ? resync(data, size, end) : end;
+  }
+  return chunks;
+}
+
+void decode(const chunk &c, const options &opts, decoded *out) {
+  auto sites = *c.sites;
+  sites.decode(c.data, c.size, [&](const cxxlog::binary::entry &e) {
+    if (e.site->severity > opts.severity || e.timestamp < opts.since ||
+        e.timestamp > opts.until ||
+        (opts.thread >= 0 && e.thread != opts.thread)) {
+      return;
+    }
+    const auto offset = out->text.size();
+    e.format(&out->text);
+    out->lines.push_back({ e.timestamp, offset, out->text.size() - offset });
+  });
+  const auto earlier = [](const decoded::line &a, const decoded::line &b) {
+    return a.timestamp < b.timestamp;
+  };
+  if (!std::is_sorted(out->lines.begin(), out->lines.end(), earlier)) {
+    std::stable_sort(out->lines.begin(), out->lines.end(), earlier);
+  }
+}
+
+/// Decodes chunks on worker threads, at most `window` chunks ahead of the
+/// oldest chunk not yet consumed by the merger.
+///
+/// Chunks are ordered by their first timestamp, which is roughly the order
+/// in which the merger needs them. A chunk needed before a worker reached
+/// it is decoded by the merger itself, so the window never stalls.
+class scheduler {
+ public:
+  scheduler(const std::vector<chunk> &chunks, const options &opts,
+      std::size_t window)
+      : chunks_(chunks), opts_(opts), window_(window),
+        states_(chunks.size(), pending), results_(chunks.size()),
+        next_(0), oldest_(0) {
+  }
+
+  void run(unsigned workers) {
+    for (unsigned i = 0; i < workers; ++i) {
+      threads_.emplace_back(&scheduler::work, this);
+    }
+  }
+
+  ~scheduler() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      next_ = chunks_.size();
+    }
+    cv_.notify_all();
+    for (auto &t : threads_) {
+      t.join();
+    }
+  }
+
+  /// Waits for the lines of a chunk, decoding it if no worker has started.
+  decoded& take(std::size_t index) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (states_[index] == pending) {
+      states_[index] = running;
+      lock.unlock();
+      decode(chunks_[index], opts_, &results_[index]);
+      lock.lock();
+      states_[index] = done;
+    }
+    cv_.wait(lock, [&] { return states_[index] == done; });
+    return results_[index];
+  }
+
+  /// Releases the lines of a chunk and lets the workers move on.
+  void release(std::size_t index) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      decoded().lines.swap(results_[index].lines);
+      decoded().text.swap(results_[index].text);
+      states_[index] = consumed;
+      while (oldest_ < states_.size() && states_[oldest_] == consumed) {
+        ++oldest_;
+      }
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  enum state { pending, running, done, consumed };
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] {
+        return next_ >= chunks_.size() || next_ < oldest_ + window_;
+      });
+      while (next_ < chunks_.size() && states_[next_] != pending) {
+        ++next_;
+      }
+      if (next_ >= chunks_.size()) {
+        return;
+      }
+      const auto index = next_++;
+      states_[index] = running;
+      lock.unlock();
+      decode(chunks_[index], opts_, &results_[index]);
+      lock.lock();
+      states_[index] = done;
+      cv_.notify_all();
+    }
+  }
+
+  const std::vector<chunk> &chunks_;
+  const options &opts_;
+  const std::size_t window_;
+  std::vector<state> states_;
+  std::vector<decoded> results_;
+  std::size_t next_;
+  std::size_t oldest_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::thread> threads_;
+};
+
+/// Parses seconds since the epoch with an optional fraction (the text of
+/// col::time) into microseconds.
+bool parse_time(const char *text, std::int64_t *out) {
+  char *end = nullptr;
+  const auto seconds = std::strtoll(text, &end, 10);
+  if (end == text) {
+    return false;
+  }
+  std::int64_t micros = 0;
+  if (*end == '.') {
+    std::int64_t scale = 100000;
+    for (++end; *end >= '0' && *end <= '9'; ++end) {
+      micros += (*end - '0') * scale;
+      scale /= 10;
+    }
+  }
+  if (*end != '\0') {
+    return false;
+  }
+  *out = seconds * 1000000 + (seconds < 0 ? -micros : micros);
+  return true;
+}
+
+bool parse_severity(const char *text, cxxlog::severity_t *out) {
+  static const char *const names[] = {
+      "none", "fatal", "error", "warning", "info", "debug", "verbose" };
+  for (int i = 0; i <= cxxlog::verbose; ++i) {
+    if (std::strcmp(text, names[i]) == 0 ||
+        (text[0] == '0' + i && text[1] == '\0')) {
+      *out = static_cast<cxxlog::severity_t>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+int usage(const char *program) {
+  std::fprintf(stderr,
+      "usage: %s [options] <binary log>...\n"
+      "  -s <severity>  records at or above the severity (fatal ... verbose)\n"
+      "  -f <time>      records at or after the time (seconds since epoch)\n"
+      "  -u <time>      records at or before the time\n"
+      "  -t <thread>    records of the thread number only\n"
+      "  -j <jobs>      number of decoding threads\n",
+      program);
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "-s" && has_value) {
+      if (!parse_severity(argv[++i], &opts.severity)) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "-f" && has_value) {
+      if (!parse_time(argv[++i], &opts.since)) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "-u" && has_value) {
+      if (!parse_time(argv[++i], &opts.until)) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "-t" && has_value) {
+      opts.thread = std::atoll(argv[++i]);
+    } else if (arg == "-j" && has_value) {
+      opts.jobs = static_cast<unsigned>(std::atoi(argv[++i]));
+    } else if (!arg.empty() && arg[0] == '-') {
+      return usage(argv[0]);
+    } else {
+      opts.files.push_back(argv[i]);
+    }
+  }
+  if (opts.files.empty()) {
+    return usage(argv[0]);
+  }
+  if (opts.jobs == 0) {
+    opts.jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // the frame headers are scanned in parallel across files
+  int result = 0;
+  std::vector<std::unique_ptr<mapped_file>> files;
+  for (const auto path : opts.files) {
+    files.emplace_back(new mapped_file(path));
+    if (!files.back()->is_open()) {
+      std::fprintf(stderr, "%s: cannot read %s\n", argv[0], path);
+      result = 1;
+    }
+  }
+  std::vector<std::vector<chunk>> split_files(files.size());
+  {
+    std::vector<std::thread> scanners;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      scanners.emplace_back([&, i] {
+        if (files[i]->is_open()) {
+          split_files[i] = split(*files[i]);
+        }
+      });
+    }
+    for (auto &t : scanners) {
+      t.join();
+    }
+  }
+
+  // chunks entirely outside of the time range are never decoded
+  std::vector<chunk> chunks;
+  for (auto &file_chunks : split_files) {
+    for (auto &c : file_chunks) {
+      if (c.first <= c.last && c.last >= opts.since && c.first <= opts.until) {
+        chunks.push_back(std::move(c));
+      }
+    }
+    file_chunks.clear();
+  }
+  std::stable_sort(chunks.begin(), chunks.end(),
+      [](const chunk &a, const chunk &b) { return a.first < b.first; });
+
+  scheduler tasks(chunks, opts, 4 * static_cast<std::size_t>(opts.jobs));
+  tasks.run(opts.jobs);
+
+  // k-way merge of the chunks, each sorted by timestamp. A chunk joins the
+  // merge when the output reaches the oldest record it may hold, so lines
+  // of concurrent threads spread over two chunks are merged as well.
+  using head = std::pair<std::int64_t, std::size_t>;
+  std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+  std::vector<decoded*> lines(chunks.size(), nullptr);
+  std::vector<std::size_t> cursors(chunks.size(), 0);
+  const auto push_next = [&](std::size_t index) {
+    if (cursors[index] < lines[index]->lines.size()) {
+      heads.push({ lines[index]->lines[cursors[index]].timestamp, index });
+    } else {
+      tasks.release(index);
+    }
+  };
+  static char output[1 << 20];
+  std::setvbuf(stdout, output, _IOFBF, sizeof(output));
+  std::size_t joined = 0;
+  for (;;) {
+    while (joined < chunks.size() &&
+           (heads.empty() || chunks[joined].first <= heads.top().first)) {
+      lines[joined] = &tasks.take(joined);
+      push_next(joined++);
+    }
+    if (heads.empty()) {
+      break;
+    }
+    const auto index = heads.top().second;
+    heads.pop();
+    const auto &l = lines[index]->lines[cursors[index]++];
+    std::fwrite(lines[index]->text.data() + l.offset, 1, l.size, stdout);
+    push_next(index);
+  }
+  std::fflush(stdout);
+  return result;
+}
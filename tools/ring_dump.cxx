@@ -0,0 +1,84 @@
+///
+/// Copyright (c) 2022 Hiroshi Nakashima
+///
+/// This software is released under the MIT License, see LICENSE.
+///
+/// Prints the records of a ring file written by cxxlog::mmap_sink, oldest
+/// first.
+///
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cxxlog/mmap_sink.hxx"
+
+namespace {
+
+/// Prints the records committed between two stream positions. The bytes of
+/// a record that was never committed (torn by a crash, or still being
+/// copied) are skipped up to the next committed record.
+void dump(const char *data, std::uint64_t capacity, std::uint64_t begin,
+    std::uint64_t end) {
+  using cxxlog::ring_record;
+  std::vector<char> text;
+  auto pos = begin;
+  while (end - pos >= ring_record::header_size) {
+    std::uint64_t tag = 0;
+    std::uint32_t size = 0;
+    ring_record::read(data, capacity, pos, &tag, sizeof(tag));
+    ring_record::read(data, capacity, pos + 8, &size, sizeof(size));
+    if (tag != ring_record::tag(pos) ||
+        end - pos - ring_record::header_size < size) {
+      ++pos;
+      continue;
+    }
+    text.resize(size);
+    ring_record::read(data, capacity, pos + ring_record::header_size,
+        text.data(), size);
+    std::fwrite(text.data(), 1, size, stdout);
+    pos += ring_record::header_size + size;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s <ring file>\n", argv[0]);
+    return 2;
+  }
+  const int fd = ::open(argv[1], O_RDONLY);
+  struct stat st;
+  if (fd < 0 || ::fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(cxxlog::ring_header)) {
+    std::fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[1]);
+    return 1;
+  }
+  const auto size = static_cast<std::size_t>(st.st_size);
+  void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::fprintf(stderr, "%s: cannot map %s\n", argv[0], argv[1]);
+    return 1;
+  }
+  const auto header = static_cast<const cxxlog::ring_header*>(mapping);
+  if (!header->valid() ||
+      header->capacity != size - sizeof(cxxlog::ring_header)) {
+    std::fprintf(stderr, "%s: %s is not a ring file\n", argv[0], argv[1]);
+    return 1;
+  }
+  const auto data = static_cast<const char*>(mapping) + header->header_size;
+  const auto cursor = header->cursor.load(std::memory_order_acquire);
+  // once the ring has wrapped, the oldest record is partially overwritten
+  // and the dump starts at the next one
+  dump(data, header->capacity,
+      (cursor > header->capacity) ? cursor - header->capacity : 0, cursor);
+  ::munmap(mapping, size);
+  return 0;
+}